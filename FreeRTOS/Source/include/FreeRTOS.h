@@ -210,6 +210,10 @@ extern "C" {
 	#define INCLUDE_xTimerPendFunctionCall 0
 #endif
 
+#ifndef configUSE_TIMER_BATCH
+	#define configUSE_TIMER_BATCH 0
+#endif
+
 #ifndef INCLUDE_xTaskGetSchedulerState
 	#define INCLUDE_xTaskGetSchedulerState 0
 #endif
@@ -562,6 +566,16 @@ extern "C" {
 	#define traceTIMER_EXPIRED( pxTimer )
 #endif
 
+#ifndef traceTIMER_CALLBACK_ENTER
+	/* Called in the timer service task just before a timer callback runs. */
+	#define traceTIMER_CALLBACK_ENTER( pxTimer )
+#endif
+
+#ifndef traceTIMER_CALLBACK_EXIT
+	/* Called in the timer service task just after a timer callback returns. */
+	#define traceTIMER_CALLBACK_EXIT( pxTimer )
+#endif
+
 #ifndef traceTIMER_COMMAND_RECEIVED
 	#define traceTIMER_COMMAND_RECEIVED( pxTimer, xMessageID, xMessageValue )
 #endif
@@ -95,6 +95,7 @@ highest numbers as tmrFIRST_FROM_ISR_COMMAND is used to determine if the task
 or interrupt version of the queue send function should be used. */
 #define tmrCOMMAND_EXECUTE_CALLBACK_FROM_ISR 	( ( BaseType_t ) -2 )
 #define tmrCOMMAND_EXECUTE_CALLBACK				( ( BaseType_t ) -1 )
+#define tmrCOMMAND_EXECUTE_BATCH				( ( BaseType_t ) -3 )
 #define tmrCOMMAND_START_DONT_TRACE				( ( BaseType_t ) 0 )
 #define tmrCOMMAND_START					    ( ( BaseType_t ) 1 )
 #define tmrCOMMAND_RESET						( ( BaseType_t ) 2 )
@@ -1298,6 +1299,87 @@ TickType_t xTimerGetPeriod( TimerHandle_t xTimer ) PRIVILEGED_FUNCTION;
 */
 TickType_t xTimerGetExpiryTime( TimerHandle_t xTimer ) PRIVILEGED_FUNCTION;
 
+/**
+ * One of the operations in a batch sent by xTimerBatchCommand().  xCommandID
+ * is tmrCOMMAND_START, tmrCOMMAND_RESET, tmrCOMMAND_STOP or
+ * tmrCOMMAND_CHANGE_PERIOD, and xNewPeriod is only used by the latter.
+ */
+typedef struct tmrTimerOperation
+{
+	TimerHandle_t xTimer;
+	BaseType_t xCommandID;
+	TickType_t xNewPeriod;
+} TimerOperation_t;
+
+/**
+ * A batch of timer operations.  The batch and its operations belong to the
+ * caller: only a pointer to the batch goes on the timer command queue, and the
+ * timer service task reads the operations when it applies them.  They must
+ * therefore not be changed, or go out of scope, while xPending is pdTRUE.
+ * xTimeSent and xPending are written by xTimerBatchCommand() and the timer
+ * service task only.
+ */
+typedef struct tmrTimerBatch
+{
+	const TimerOperation_t *pxOperations;
+	UBaseType_t uxCount;
+	TickType_t xTimeSent;
+	volatile BaseType_t xPending;
+} TimerBatch_t;
+
+/**
+ * BaseType_t xTimerBatchCommand( TimerBatch_t * const pxBatch,
+ *                                TickType_t xTicksToWait );
+ *
+ * Sends a batch of timer operations to the timer service task as a single
+ * message on the timer command queue, so they use one queue space between
+ * them, however many there are, and are applied together, in the order given.
+ * The message only carries a pointer to the batch, so it is no larger than any
+ * other timer command.  Each operation behaves exactly as the equivalent
+ * xTimerStart(), xTimerReset(), xTimerStop() or xTimerChangePeriod() call
+ * would have.  Only available if configUSE_TIMER_BATCH is 1.  Must not be
+ * called from an interrupt.
+ *
+ * @param pxBatch The batch, with pxOperations and uxCount (at least 1) set.
+ * It must not be pending already.  xPending is pdTRUE from the moment the
+ * batch is queued until the timer service task has applied it.
+ *
+ * @param xTicksToWait The time the calling task should remain in the Blocked
+ * state for space to become available on the timer command queue, as for
+ * xTimerStart().
+ *
+ * @return pdFAIL if the batch could not be queued before xTicksToWait ticks
+ * had passed, in which case none of the operations is performed and the batch
+ * is not pending.  pdPASS otherwise.
+ *
+ * Example usage:
+ * @verbatim
+ * // Stop one timer and start another with one queue message.
+ * static const TimerOperation_t xOperations[ 2 ] =
+ * {
+ *     { xTimerA, tmrCOMMAND_STOP, 0 },
+ *     { xTimerB, tmrCOMMAND_START, 0 }
+ * };
+ * static TimerBatch_t xBatch = { xOperations, 2 };
+ *
+ * if( xBatch.xPending == pdFALSE )
+ * {
+ *     xTimerBatchCommand( &xBatch, 0 );
+ * }
+ * @endverbatim
+ */
+BaseType_t xTimerBatchCommand( TimerBatch_t * const pxBatch, const TickType_t xTicksToWait ) PRIVILEGED_FUNCTION;
+
+/**
+ * UBaseType_t uxTimerGetDroppedCommands( void );
+ *
+ * Returns the number of timer commands (single or batched) that could not be
+ * sent because the timer command queue was still full when the block time
+ * expired.  A dropped command is otherwise only visible in its return value,
+ * which is easily ignored when the block time is 0.
+ */
+UBaseType_t uxTimerGetDroppedCommands( void ) PRIVILEGED_FUNCTION;
+
 /*
  * Functions beyond this part are not part of the public API and are intended
  * for use by the kernel only.
@@ -155,6 +155,12 @@ typedef struct tmrTimerQueueMessage
 		#if ( INCLUDE_xTimerPendFunctionCall == 1 )
 			CallbackParameters_t xCallbackParameters;
 		#endif /* INCLUDE_xTimerPendFunctionCall */
+
+		/* A batch is sent as a pointer to the caller's batch, so it never
+		makes the structure larger. */
+		#if ( configUSE_TIMER_BATCH == 1 )
+			TimerBatch_t *pxBatch;
+		#endif /* configUSE_TIMER_BATCH */
 	} u;
 } DaemonTaskMessage_t;
 
@@ -173,6 +179,9 @@ PRIVILEGED_DATA static List_t *pxOverflowTimerList;
 PRIVILEGED_DATA static QueueHandle_t xTimerQueue = NULL;
 PRIVILEGED_DATA static TaskHandle_t xTimerTaskHandle = NULL;
 
+/* Timer commands that could not be queued because the queue stayed full. */
+PRIVILEGED_DATA static volatile UBaseType_t uxDroppedCommands = ( UBaseType_t ) 0U;
+
 /*lint +e956 */
 
 /*-----------------------------------------------------------*/
@@ -206,6 +215,17 @@ static void prvTimerTask( void *pvParameters ) PRIVILEGED_FUNCTION;
  */
 static void prvProcessReceivedCommands( void ) PRIVILEGED_FUNCTION;
 
+/*
+ * Called by prvProcessReceivedCommands() to apply one command to one timer,
+ * whether it arrived on its own or as part of a batch.
+ */
+static void prvProcessTimerCommand( const BaseType_t xCommandID, const TimerParameter_t * const pxParameters ) PRIVILEGED_FUNCTION;
+
+/*
+ * Counts a timer command that could not be sent.
+ */
+static void prvCountDroppedCommand( const BaseType_t xFromISR ) PRIVILEGED_FUNCTION;
+
 /*
  * Insert the timer into either xActiveTimerList1, or xActiveTimerList2,
  * depending on if the expire time causes a timer counter overflow.
@@ -446,6 +466,15 @@ DaemonTaskMessage_t xMessage;
 			xReturn = xQueueSendToBackFromISR( xTimerQueue, &xMessage, pxHigherPriorityTaskWoken );
 		}
 
+		if( xReturn != pdPASS )
+		{
+			prvCountDroppedCommand( ( BaseType_t ) ( xCommandID >= tmrFIRST_FROM_ISR_COMMAND ) );
+		}
+		else
+		{
+			mtCOVERAGE_TEST_MARKER();
+		}
+
 		traceTIMER_COMMAND_SEND( xTimer, xCommandID, xOptionalValue, xReturn );
 	}
 	else
@@ -457,6 +486,93 @@ DaemonTaskMessage_t xMessage;
 }
 /*-----------------------------------------------------------*/
 
+#if ( configUSE_TIMER_BATCH == 1 )
+
+	BaseType_t xTimerBatchCommand( TimerBatch_t * const pxBatch, const TickType_t xTicksToWait )
+	{
+	BaseType_t xReturn = pdFAIL;
+	DaemonTaskMessage_t xMessage;
+	UBaseType_t uxIndex;
+
+		configASSERT( pxBatch );
+		configASSERT( pxBatch->pxOperations );
+		configASSERT( pxBatch->uxCount > ( UBaseType_t ) 0U );
+		configASSERT( pxBatch->xPending == pdFALSE );
+
+		if( xTimerQueue != NULL )
+		{
+			/* Starts and resets are timed from the moment the batch is sent,
+			exactly as if xTimerStart() or xTimerReset() had been called. */
+			pxBatch->xTimeSent = xTaskGetTickCount();
+			pxBatch->xPending = pdTRUE;
+
+			xMessage.xMessageID = tmrCOMMAND_EXECUTE_BATCH;
+			xMessage.u.pxBatch = pxBatch;
+
+			if( xTaskGetSchedulerState() == taskSCHEDULER_RUNNING )
+			{
+				xReturn = xQueueSendToBack( xTimerQueue, &xMessage, xTicksToWait );
+			}
+			else
+			{
+				xReturn = xQueueSendToBack( xTimerQueue, &xMessage, tmrNO_DELAY );
+			}
+
+			if( xReturn != pdPASS )
+			{
+				pxBatch->xPending = pdFALSE;
+				prvCountDroppedCommand( pdFALSE );
+			}
+			else
+			{
+				mtCOVERAGE_TEST_MARKER();
+			}
+
+			for( uxIndex = 0; uxIndex < pxBatch->uxCount; uxIndex++ )
+			{
+				traceTIMER_COMMAND_SEND( pxBatch->pxOperations[ uxIndex ].xTimer, pxBatch->pxOperations[ uxIndex ].xCommandID, pxBatch->xTimeSent, xReturn );
+			}
+		}
+		else
+		{
+			mtCOVERAGE_TEST_MARKER();
+		}
+
+		return xReturn;
+	}
+
+#endif /* configUSE_TIMER_BATCH */
+/*-----------------------------------------------------------*/
+
+static void prvCountDroppedCommand( const BaseType_t xFromISR )
+{
+UBaseType_t uxSavedInterruptStatus;
+
+	if( xFromISR != pdFALSE )
+	{
+		uxSavedInterruptStatus = portSET_INTERRUPT_MASK_FROM_ISR();
+		{
+			uxDroppedCommands++;
+		}
+		portCLEAR_INTERRUPT_MASK_FROM_ISR( uxSavedInterruptStatus );
+	}
+	else
+	{
+		taskENTER_CRITICAL();
+		{
+			uxDroppedCommands++;
+		}
+		taskEXIT_CRITICAL();
+	}
+}
+/*-----------------------------------------------------------*/
+
+UBaseType_t uxTimerGetDroppedCommands( void )
+{
+	return uxDroppedCommands;
+}
+/*-----------------------------------------------------------*/
+
 TaskHandle_t xTimerGetTimerDaemonTaskHandle( void )
 {
 	/* If xTimerGetTimerDaemonTaskHandle() is called before the scheduler has been
@@ -531,7 +647,9 @@ Timer_t * const pxTimer = ( Timer_t * ) listGET_OWNER_OF_HEAD_ENTRY( pxCurrentTi
 	}
 
 	/* Call the timer callback. */
+	traceTIMER_CALLBACK_ENTER( pxTimer );
 	pxTimer->pxCallbackFunction( ( TimerHandle_t ) pxTimer );
+	traceTIMER_CALLBACK_EXIT( pxTimer );
 }
 /*-----------------------------------------------------------*/
 
@@ -724,12 +842,46 @@ BaseType_t xProcessTimerNow = pdFALSE;
 static void	prvProcessReceivedCommands( void )
 {
 DaemonTaskMessage_t xMessage;
-Timer_t *pxTimer;
-BaseType_t xTimerListsWereSwitched, xResult;
-TickType_t xTimeNow;
+#if ( configUSE_TIMER_BATCH == 1 )
+	TimerBatch_t *pxBatch;
+	const TimerOperation_t *pxOperation;
+	TimerParameter_t xParameters;
+	UBaseType_t uxIndex;
+#endif
 
 	while( xQueueReceive( xTimerQueue, &xMessage, tmrNO_DELAY ) != pdFAIL ) /*lint !e603 xMessage does not have to be initialised as it is passed out, not in, and it is not used unless xQueueReceive() returns pdTRUE. */
 	{
+		#if ( configUSE_TIMER_BATCH == 1 )
+		{
+			/* A batch points at several timer commands, which are applied in
+			the order they were given.  The sender may reuse the batch once
+			it is no longer pending. */
+			if( xMessage.xMessageID == tmrCOMMAND_EXECUTE_BATCH )
+			{
+				pxBatch = xMessage.u.pxBatch;
+				for( uxIndex = 0; uxIndex < pxBatch->uxCount; uxIndex++ )
+				{
+					pxOperation = &( pxBatch->pxOperations[ uxIndex ] );
+					configASSERT( pxOperation->xTimer );
+					configASSERT( ( pxOperation->xCommandID >= tmrCOMMAND_START ) && ( pxOperation->xCommandID <= tmrCOMMAND_CHANGE_PERIOD ) );
+
+					xParameters.pxTimer = ( Timer_t * ) pxOperation->xTimer;
+					if( pxOperation->xCommandID == tmrCOMMAND_CHANGE_PERIOD )
+					{
+						xParameters.xMessageValue = pxOperation->xNewPeriod;
+					}
+					else
+					{
+						xParameters.xMessageValue = pxBatch->xTimeSent;
+					}
+					prvProcessTimerCommand( pxOperation->xCommandID, &xParameters );
+				}
+				pxBatch->xPending = pdFALSE;
+				continue;
+			}
+		}
+		#endif /* configUSE_TIMER_BATCH */
+
 		#if ( INCLUDE_xTimerPendFunctionCall == 1 )
 		{
 			/* Negative commands are pended function calls rather than timer
@@ -758,112 +910,124 @@ TickType_t xTimeNow;
 		{
 			/* The messages uses the xTimerParameters member to work on a
 			software timer. */
-			pxTimer = xMessage.u.xTimerParameters.pxTimer;
+			prvProcessTimerCommand( xMessage.xMessageID, &( xMessage.u.xTimerParameters ) );
+		}
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvProcessTimerCommand( const BaseType_t xCommandID, const TimerParameter_t * const pxParameters )
+{
+Timer_t *pxTimer;
+BaseType_t xTimerListsWereSwitched, xResult;
+TickType_t xTimeNow;
 
-			if( listIS_CONTAINED_WITHIN( NULL, &( pxTimer->xTimerListItem ) ) == pdFALSE )
+	pxTimer = pxParameters->pxTimer;
+
+	if( listIS_CONTAINED_WITHIN( NULL, &( pxTimer->xTimerListItem ) ) == pdFALSE )
+	{
+		/* The timer is in a list, remove it. */
+		( void ) uxListRemove( &( pxTimer->xTimerListItem ) );
+	}
+	else
+	{
+		mtCOVERAGE_TEST_MARKER();
+	}
+
+	traceTIMER_COMMAND_RECEIVED( pxTimer, xCommandID, pxParameters->xMessageValue );
+
+	/* In this case the xTimerListsWereSwitched parameter is not used, but
+	it must be present in the function call.  prvSampleTimeNow() must be
+	called after the message is received from xTimerQueue so there is no
+	possibility of a higher priority task adding a message to the message
+	queue with a time that is ahead of the timer daemon task (because it
+	pre-empted the timer daemon task after the xTimeNow value was set). */
+	xTimeNow = prvSampleTimeNow( &xTimerListsWereSwitched );
+
+	switch( xCommandID )
+	{
+		case tmrCOMMAND_START :
+	    case tmrCOMMAND_START_FROM_ISR :
+	    case tmrCOMMAND_RESET :
+	    case tmrCOMMAND_RESET_FROM_ISR :
+		case tmrCOMMAND_START_DONT_TRACE :
+			/* Start or restart a timer. */
+			if( prvInsertTimerInActiveList( pxTimer,  pxParameters->xMessageValue + pxTimer->xTimerPeriodInTicks, xTimeNow, pxParameters->xMessageValue ) != pdFALSE )
 			{
-				/* The timer is in a list, remove it. */
-				( void ) uxListRemove( &( pxTimer->xTimerListItem ) );
+				/* The timer expired before it was added to the active
+				timer list.  Process it now. */
+				traceTIMER_CALLBACK_ENTER( pxTimer );
+				pxTimer->pxCallbackFunction( ( TimerHandle_t ) pxTimer );
+				traceTIMER_CALLBACK_EXIT( pxTimer );
+				traceTIMER_EXPIRED( pxTimer );
+
+				if( pxTimer->uxAutoReload == ( UBaseType_t ) pdTRUE )
+				{
+					xResult = xTimerGenericCommand( pxTimer, tmrCOMMAND_START_DONT_TRACE, pxParameters->xMessageValue + pxTimer->xTimerPeriodInTicks, NULL, tmrNO_DELAY );
+					configASSERT( xResult );
+					( void ) xResult;
+				}
+				else
+				{
+					mtCOVERAGE_TEST_MARKER();
+				}
 			}
 			else
 			{
 				mtCOVERAGE_TEST_MARKER();
 			}
-
-			traceTIMER_COMMAND_RECEIVED( pxTimer, xMessage.xMessageID, xMessage.u.xTimerParameters.xMessageValue );
-
-			/* In this case the xTimerListsWereSwitched parameter is not used, but
-			it must be present in the function call.  prvSampleTimeNow() must be
-			called after the message is received from xTimerQueue so there is no
-			possibility of a higher priority task adding a message to the message
-			queue with a time that is ahead of the timer daemon task (because it
-			pre-empted the timer daemon task after the xTimeNow value was set). */
-			xTimeNow = prvSampleTimeNow( &xTimerListsWereSwitched );
-
-			switch( xMessage.xMessageID )
+			break;
+
+		case tmrCOMMAND_STOP :
+		case tmrCOMMAND_STOP_FROM_ISR :
+			/* The timer has already been removed from the active list.
+			There is nothing to do here. */
+			break;
+
+		case tmrCOMMAND_CHANGE_PERIOD :
+		case tmrCOMMAND_CHANGE_PERIOD_FROM_ISR :
+			pxTimer->xTimerPeriodInTicks = pxParameters->xMessageValue;
+			configASSERT( ( pxTimer->xTimerPeriodInTicks > 0 ) );
+
+			/* The new period does not really have a reference, and can
+			be longer or shorter than the old one.  The command time is
+			therefore set to the current time, and as the period cannot
+			be zero the next expiry time can only be in the future,
+			meaning (unlike for the xTimerStart() case above) there is
+			no fail case that needs to be handled here. */
+			( void ) prvInsertTimerInActiveList( pxTimer, ( xTimeNow + pxTimer->xTimerPeriodInTicks ), xTimeNow, xTimeNow );
+			break;
+
+		case tmrCOMMAND_DELETE :
+			/* The timer has already been removed from the active list,
+			just free up the memory if the memory was dynamically
+			allocated. */
+			#if( ( configSUPPORT_DYNAMIC_ALLOCATION == 1 ) && ( configSUPPORT_STATIC_ALLOCATION == 0 ) )
 			{
-				case tmrCOMMAND_START :
-			    case tmrCOMMAND_START_FROM_ISR :
-			    case tmrCOMMAND_RESET :
-			    case tmrCOMMAND_RESET_FROM_ISR :
-				case tmrCOMMAND_START_DONT_TRACE :
-					/* Start or restart a timer. */
-					if( prvInsertTimerInActiveList( pxTimer,  xMessage.u.xTimerParameters.xMessageValue + pxTimer->xTimerPeriodInTicks, xTimeNow, xMessage.u.xTimerParameters.xMessageValue ) != pdFALSE )
-					{
-						/* The timer expired before it was added to the active
-						timer list.  Process it now. */
-						pxTimer->pxCallbackFunction( ( TimerHandle_t ) pxTimer );
-						traceTIMER_EXPIRED( pxTimer );
-
-						if( pxTimer->uxAutoReload == ( UBaseType_t ) pdTRUE )
-						{
-							xResult = xTimerGenericCommand( pxTimer, tmrCOMMAND_START_DONT_TRACE, xMessage.u.xTimerParameters.xMessageValue + pxTimer->xTimerPeriodInTicks, NULL, tmrNO_DELAY );
-							configASSERT( xResult );
-							( void ) xResult;
-						}
-						else
-						{
-							mtCOVERAGE_TEST_MARKER();
-						}
-					}
-					else
-					{
-						mtCOVERAGE_TEST_MARKER();
-					}
-					break;
-
-				case tmrCOMMAND_STOP :
-				case tmrCOMMAND_STOP_FROM_ISR :
-					/* The timer has already been removed from the active list.
-					There is nothing to do here. */
-					break;
-
-				case tmrCOMMAND_CHANGE_PERIOD :
-				case tmrCOMMAND_CHANGE_PERIOD_FROM_ISR :
-					pxTimer->xTimerPeriodInTicks = xMessage.u.xTimerParameters.xMessageValue;
-					configASSERT( ( pxTimer->xTimerPeriodInTicks > 0 ) );
-
-					/* The new period does not really have a reference, and can
-					be longer or shorter than the old one.  The command time is
-					therefore set to the current time, and as the period cannot
-					be zero the next expiry time can only be in the future,
-					meaning (unlike for the xTimerStart() case above) there is
-					no fail case that needs to be handled here. */
-					( void ) prvInsertTimerInActiveList( pxTimer, ( xTimeNow + pxTimer->xTimerPeriodInTicks ), xTimeNow, xTimeNow );
-					break;
-
-				case tmrCOMMAND_DELETE :
-					/* The timer has already been removed from the active list,
-					just free up the memory if the memory was dynamically
-					allocated. */
-					#if( ( configSUPPORT_DYNAMIC_ALLOCATION == 1 ) && ( configSUPPORT_STATIC_ALLOCATION == 0 ) )
-					{
-						/* The timer can only have been allocated dynamically -
-						free it again. */
-						vPortFree( pxTimer );
-					}
-					#elif( ( configSUPPORT_DYNAMIC_ALLOCATION == 1 ) && ( configSUPPORT_STATIC_ALLOCATION == 1 ) )
-					{
-						/* The timer could have been allocated statically or
-						dynamically, so check before attempting to free the
-						memory. */
-						if( pxTimer->ucStaticallyAllocated == ( uint8_t ) pdFALSE )
-						{
-							vPortFree( pxTimer );
-						}
-						else
-						{
-							mtCOVERAGE_TEST_MARKER();
-						}
-					}
-					#endif /* configSUPPORT_DYNAMIC_ALLOCATION */
-					break;
-
-				default	:
-					/* Don't expect to get here. */
-					break;
+				/* The timer can only have been allocated dynamically -
+				free it again. */
+				vPortFree( pxTimer );
 			}
-		}
+			#elif( ( configSUPPORT_DYNAMIC_ALLOCATION == 1 ) && ( configSUPPORT_STATIC_ALLOCATION == 1 ) )
+			{
+				/* The timer could have been allocated statically or
+				dynamically, so check before attempting to free the
+				memory. */
+				if( pxTimer->ucStaticallyAllocated == ( uint8_t ) pdFALSE )
+				{
+					vPortFree( pxTimer );
+				}
+				else
+				{
+					mtCOVERAGE_TEST_MARKER();
+				}
+			}
+			#endif /* configSUPPORT_DYNAMIC_ALLOCATION */
+			break;
+
+		default	:
+			/* Don't expect to get here. */
+			break;
 	}
 }
 /*-----------------------------------------------------------*/
@@ -891,7 +1055,9 @@ BaseType_t xResult;
 		/* Execute its callback, then send a command to restart the timer if
 		it is an auto-reload timer.  It cannot be restarted here as the lists
 		have not yet been switched. */
+		traceTIMER_CALLBACK_ENTER( pxTimer );
 		pxTimer->pxCallbackFunction( ( TimerHandle_t ) pxTimer );
+		traceTIMER_CALLBACK_EXIT( pxTimer );
 
 		if( pxTimer->uxAutoReload == ( UBaseType_t ) pdTRUE )
 		{
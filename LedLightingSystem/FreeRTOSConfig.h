@@ -110,8 +110,15 @@
 #define configUSE_TIMERS 1
 #define configTIMER_TASK_PRIORITY 3
 #define configTIMER_QUEUE_LENGTH 10
+#define configUSE_TIMER_BATCH 1
 #define configTIMER_TASK_STACK_DEPTH configMINIMAL_STACK_SIZE 
 
+/* Time every timer callback (timerstats.c) */
+extern void vTimerStatsEnter( void );
+extern void vTimerStatsExit( void *pvTimer );
+#define traceTIMER_CALLBACK_ENTER( pxTimer )	vTimerStatsEnter()
+#define traceTIMER_CALLBACK_EXIT( pxTimer )		vTimerStatsExit( ( void * ) ( pxTimer ) )
+
 /* Set the following definitions to 1 to include the API function, or zero
 to exclude the API function. */
 
@@ -122,5 +129,6 @@ to exclude the API function. */
 #define INCLUDE_vTaskSuspend			1
 #define INCLUDE_vTaskDelayUntil			1
 #define INCLUDE_vTaskDelay				1
+#define INCLUDE_xTaskGetCurrentTaskHandle	1
 
 #endif /* FREERTOS_CONFIG_H */
@@ -0,0 +1,275 @@
+/*
+	Lighting event bus. Tasks subscribe to topics (zone state, alarm)
+	and each subscriber has its own queue of events. An event
+	published on a topic is stored once, in a message from the
+	fan-out pool (fanout.c), and a pointer to it goes on the queue of
+	every subscriber to that topic; the task of the subscriber is sent
+	its notification bits, so it can wait for events together with
+	anything else it is notified of. The queues are rings of pointers
+	kept here, filled in a short critical section, so an interrupt
+	publishing in the middle of a task's publish cannot reorder them.
+
+	Publishing never blocks, from a task or an interrupt. Every event
+	gets a sequence number, and the bus keeps the latest event of
+	each topic. When a subscriber's queue is full (or the pool is
+	empty) the subscriber is marked overflowed: it skips that event
+	and every later one until it has emptied its queue, so nothing
+	overtakes an older event. It then receives the latest event of
+	each topic it skipped, oldest first, and carries on from the
+	queue. Both topics carry states (the zones, and the alarm phase
+	or shutdown), so an overflowed subscriber skips intermediate
+	events but always catches up with the current state; events are
+	never reordered. The skips are counted.
+
+	The "bus" console command prints the events published per topic
+	and, per subscriber, those queued, those skipped, how often it
+	overflowed and the deepest its queue has been.
+
+	Wesley Fung (fungw@tcd.ie)
+*/
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include <stdio.h>
+#include "bus.h"
+#include "fanout.h"
+
+typedef struct BusSubscriber {
+	const char *pcName;
+	unsigned long ulTopics;
+	xTaskHandle xTask;
+	unsigned long ulNotifyBits;
+	FanOutMessage *pxQueue[busQUEUE_LENGTH];
+	unsigned portBASE_TYPE uxFirst;
+	unsigned portBASE_TYPE uxCount;
+	/* Topics skipped since the queue overflowed; none if it has not */
+	unsigned long ulSkipped;
+	/* Statistics */
+	unsigned long ulQueued;
+	unsigned long ulSkippedCount;
+	unsigned long ulOverflows;
+	unsigned portBASE_TYPE uxPeak;
+} BusSubscriber;
+
+static BusSubscriber xSubscribers[busMAX_SUBSCRIBERS];
+static unsigned portBASE_TYPE uxSubscribers;
+
+/* Latest event of each topic and its sequence number */
+static unsigned long ulSequence;
+static Command xLatest[busNUM_TOPICS];
+static unsigned long ulLatestSequence[busNUM_TOPICS];
+static unsigned long ulPublished[busNUM_TOPICS];
+
+static const char * const pcTopicNames[busNUM_TOPICS] = { "zone state", "alarm" };
+
+/*
+	prvSkip()
+	- Description: A subscriber misses an event; interrupts must be
+	masked
+	- Parameters: pxSub - subscriber
+								ulTopic - busTOPIC() of the event
+*/
+static void prvSkip( BusSubscriber *pxSub, unsigned long ulTopic ) {
+	if (pxSub->ulSkipped == 0) {
+		pxSub->ulOverflows++;
+	}
+	pxSub->ulSkipped |= ulTopic;
+	pxSub->ulSkippedCount++;
+}
+
+/*
+	prvPublish()
+	- Description: Delivers an event to every subscriber to its
+	topic; interrupts must be masked
+	- Parameters: uxTopic - bus... topic
+								event - event
+	- Returns: the subscribers to notify, bit per subscriber
+*/
+static unsigned long prvPublish( unsigned portBASE_TYPE uxTopic, Command event ) {
+	BusSubscriber *pxSub;
+	FanOutMessage *pxMessage = NULL;
+	unsigned long ulTopic = busTOPIC(uxTopic);
+	unsigned long ulNotify = 0;
+	unsigned long ulDeliver = 0;
+	unsigned portBASE_TYPE uxRefs = 0;
+	unsigned portBASE_TYPE i;
+
+	ulPublished[uxTopic]++;
+	xLatest[uxTopic] = event;
+	ulLatestSequence[uxTopic] = ++ulSequence;
+
+	for (i = 0; i < uxSubscribers; i++) {
+		pxSub = &xSubscribers[i];
+		if ((pxSub->ulTopics & ulTopic) == 0) {
+			continue;
+		}
+		ulNotify |= 1UL << i;
+		if ((pxSub->ulSkipped == 0) && (pxSub->uxCount < busQUEUE_LENGTH)) {
+			ulDeliver |= 1UL << i;
+			uxRefs++;
+		} else {
+			prvSkip(pxSub, ulTopic);
+		}
+	}
+
+	if (uxRefs != 0) {
+		pxMessage = pxFanOutAlloc(event, uxRefs);
+	}
+	for (i = 0; i < uxSubscribers; i++) {
+		if ((ulDeliver & (1UL << i)) == 0) {
+			continue;
+		}
+		pxSub = &xSubscribers[i];
+		if (pxMessage == NULL) {
+			prvSkip(pxSub, ulTopic);
+			continue;
+		}
+		pxSub->pxQueue[(pxSub->uxFirst + pxSub->uxCount) % busQUEUE_LENGTH] = pxMessage;
+		pxSub->uxCount++;
+		pxSub->ulQueued++;
+		if (pxSub->uxCount > pxSub->uxPeak) {
+			pxSub->uxPeak = pxSub->uxCount;
+		}
+	}
+
+	return ulNotify;
+}
+
+/*
+	xBusSubscribe()
+	- Description: Adds a subscriber. Must be called before the
+	scheduler starts.
+	- Parameters: pcName - name shown by the console
+								ulTopics - busTOPIC() of each topic wanted
+								xTask - task notified of each event; may be NULL
+								ulNotifyBits - bits set in its notification value
+								puxSubscriber - receives the subscriber, for xBusReceive()
+	- Returns: pdPASS, or pdFAIL if there is no room for it
+*/
+portBASE_TYPE xBusSubscribe( const char *pcName, unsigned long ulTopics, xTaskHandle xTask, unsigned long ulNotifyBits, unsigned portBASE_TYPE *puxSubscriber ) {
+	BusSubscriber *pxSub;
+
+	if (uxSubscribers >= busMAX_SUBSCRIBERS) {
+		return pdFAIL;
+	}
+	pxSub = &xSubscribers[uxSubscribers];
+	pxSub->pcName = pcName;
+	pxSub->ulTopics = ulTopics;
+	pxSub->xTask = xTask;
+	pxSub->ulNotifyBits = ulNotifyBits;
+	*puxSubscriber = uxSubscribers++;
+	return pdPASS;
+}
+
+/*
+	vBusPublish()
+	- Description: Publishes an event from a task, without blocking
+	- Parameters: uxTopic - bus... topic
+								event - event
+*/
+void vBusPublish( unsigned portBASE_TYPE uxTopic, Command event ) {
+	unsigned long ulNotify;
+	unsigned portBASE_TYPE i;
+
+	portENTER_CRITICAL();
+	ulNotify = prvPublish(uxTopic, event);
+	portEXIT_CRITICAL();
+
+	for (i = 0; i < uxSubscribers; i++) {
+		if ((ulNotify & (1UL << i)) && (xSubscribers[i].xTask != NULL)) {
+			xTaskNotify(xSubscribers[i].xTask, xSubscribers[i].ulNotifyBits, eSetBits);
+		}
+	}
+}
+
+/*
+	vBusPublishFromISR()
+	- Description: Publishes an event from an interrupt
+	- Parameters: uxTopic - bus... topic
+								event - event
+								pxHigherPriorityTaskWoken - set if a subscriber was woken
+*/
+void vBusPublishFromISR( unsigned portBASE_TYPE uxTopic, Command event, portBASE_TYPE *pxHigherPriorityTaskWoken ) {
+	unsigned long ulNotify;
+	unsigned portBASE_TYPE i;
+
+	/* Interrupts are already masked */
+	ulNotify = prvPublish(uxTopic, event);
+
+	for (i = 0; i < uxSubscribers; i++) {
+		if ((ulNotify & (1UL << i)) && (xSubscribers[i].xTask != NULL)) {
+			xTaskNotifyFromISR(xSubscribers[i].xTask, xSubscribers[i].ulNotifyBits, eSetBits, pxHigherPriorityTaskWoken);
+		}
+	}
+}
+
+/*
+	xBusReceive()
+	- Description: Takes the oldest event of a subscriber, without
+	blocking; wait for the notification bits to know there is one
+	- Parameters: uxSubscriber - from xBusSubscribe()
+								pxEvent - receives the event
+	- Returns: pdPASS, or pdFAIL if there are no events
+*/
+portBASE_TYPE xBusReceive( unsigned portBASE_TYPE uxSubscriber, Command *pxEvent ) {
+	BusSubscriber *pxSub = &xSubscribers[uxSubscriber];
+	FanOutMessage *pxMessage = NULL;
+	portBASE_TYPE xReturn = pdFAIL;
+	unsigned portBASE_TYPE uxTopic, uxOldest = busNUM_TOPICS;
+
+	portENTER_CRITICAL();
+	if (pxSub->uxCount != 0) {
+		pxMessage = pxSub->pxQueue[pxSub->uxFirst];
+		pxSub->uxFirst = (pxSub->uxFirst + 1) % busQUEUE_LENGTH;
+		pxSub->uxCount--;
+	} else if (pxSub->ulSkipped != 0) {
+		/* Caught up: the latest of each skipped topic, oldest first */
+		for (uxTopic = 0; uxTopic < busNUM_TOPICS; uxTopic++) {
+			if ((pxSub->ulSkipped & busTOPIC(uxTopic)) && ((uxOldest == busNUM_TOPICS) ||
+				((long) (ulLatestSequence[uxTopic] - ulLatestSequence[uxOldest]) < 0))) {
+				uxOldest = uxTopic;
+			}
+		}
+		*pxEvent = xLatest[uxOldest];
+		pxSub->ulSkipped &= ~busTOPIC(uxOldest);
+		xReturn = pdPASS;
+	}
+	portEXIT_CRITICAL();
+
+	if (pxMessage != NULL) {
+		*pxEvent = pxMessage->xEvent;
+		vFanOutRelease(pxMessage);
+		xReturn = pdPASS;
+	}
+	return xReturn;
+}
+
+/*
+	vBusPrintStats()
+	- Description: Prints the events published per topic and the
+	statistics of every subscriber on the console
+	- Parameters: N/A
+*/
+void vBusPrintStats( void ) {
+	BusSubscriber xCopy;
+	unsigned long ulCopy[busNUM_TOPICS];
+	unsigned portBASE_TYPE i;
+
+	portENTER_CRITICAL();
+	for (i = 0; i < busNUM_TOPICS; i++) {
+		ulCopy[i] = ulPublished[i];
+	}
+	portEXIT_CRITICAL();
+	for (i = 0; i < busNUM_TOPICS; i++) {
+		printf("Bus %s: %lu published\r\n", pcTopicNames[i], ulCopy[i]);
+	}
+
+	for (i = 0; i < uxSubscribers; i++) {
+		portENTER_CRITICAL();
+		xCopy = xSubscribers[i];
+		portEXIT_CRITICAL();
+
+		printf("Bus subscriber %s: %lu queued, %lu skipped, %lu overflows, peak %lu queued\r\n",
+			xCopy.pcName, xCopy.ulQueued, xCopy.ulSkippedCount, xCopy.ulOverflows, (unsigned long) xCopy.uxPeak);
+	}
+}
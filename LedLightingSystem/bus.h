@@ -0,0 +1,26 @@
+#ifndef BUS_H
+#define BUS_H
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "commands.h"
+
+/* Topics; an event is a Command word */
+#define busZONE_STATE			0	/* cmdLCD_REFLECT, state: zones */
+#define busALARM				1	/* cmdLCD_SHUTDOWN, cmdLCD_FIRE_... */
+#define busNUM_TOPICS			2
+
+/* Topic set of a subscription */
+#define busTOPIC( topic )		( ( unsigned long ) 1 << ( topic ) )
+
+/* Subscribers, and the events each one's queue holds */
+#define busMAX_SUBSCRIBERS		4
+#define busQUEUE_LENGTH			16
+
+portBASE_TYPE xBusSubscribe( const char *pcName, unsigned long ulTopics, xTaskHandle xTask, unsigned long ulNotifyBits, unsigned portBASE_TYPE *puxSubscriber );
+void vBusPublish( unsigned portBASE_TYPE uxTopic, Command event );
+void vBusPublishFromISR( unsigned portBASE_TYPE uxTopic, Command event, portBASE_TYPE *pxHigherPriorityTaskWoken );
+portBASE_TYPE xBusReceive( unsigned portBASE_TYPE uxSubscriber, Command *pxEvent );
+void vBusPrintStats( void );
+
+#endif
@@ -0,0 +1,182 @@
+/*
+	Command coalescing between the UI and the sensors task. Only the
+	last switch or dim of a zone matters, so each zone keeps one
+	target command and a dirty bit; a later command for the zone
+	replaces the target. The sensors task takes the targets each time
+	it has drained its queue, so a zone command only needs to wake it
+	when the queue is empty: it then sends a single cmdZONE_TARGETS
+	token, reserved in a critical section and sent outside it. The
+	token therefore never takes the room of another command, and a
+	zone command is never lost, however fast the slider is tapped.
+
+	Other commands (master switch, presets, vacancy) still go through
+	the queue in order. Targets must not overtake them, so posting
+	one first moves the dirty targets onto the queue ahead of it,
+	with the scheduler suspended so no other post comes in between.
+	Only tasks post to the queue, so the room checked there is still
+	free when the targets and the command are sent; if there is not
+	room for all of them nothing is moved and the command is refused.
+	The sensors task drains the queue before it takes the targets,
+	and xCoalesceTake() only hands them over while the queue is
+	empty, so every target it gets is newer than everything already
+	applied.
+
+	Producers are tasks (the LCD task and timer callbacks). The
+	"coalesce" console command prints the commands posted, the zone
+	commands replaced before they were applied, those moved onto the
+	queue and the other commands refused by a full queue.
+
+	Wesley Fung (fungw@tcd.ie)
+*/
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include <stdio.h>
+#include "coalesce.h"
+#include "evlog.h"
+
+static xQueueHandle xCmdQ;
+static Command xTargets[NUM_ZONES];
+static unsigned char ucDirty;
+/* A cmdZONE_TARGETS token is on the queue */
+static portBASE_TYPE xTokenQueued;
+
+/* Statistics */
+static unsigned long ulPosted;
+static unsigned long ulReplaced;
+static unsigned long ulMoved;
+static unsigned long ulRefused;
+
+/*
+	vCoalesceInit()
+	- Description: Sets the queue of the sensors task. Must be
+	called before the scheduler starts.
+	- Parameters: xQueue - sensors command queue
+*/
+void vCoalesceInit( xQueueHandle xQueue ) {
+	xCmdQ = xQueue;
+}
+
+/*
+	xCoalescePost()
+	- Description: Sends a command to the sensors task from a task,
+	without blocking. A switch or dim of a zone becomes its target.
+	- Parameters: cmd - command
+	- Returns: pdPASS, or pdFAIL if the sensors queue had no room for
+	a command other than a zone switch or dim
+*/
+portBASE_TYPE xCoalescePost( Command cmd ) {
+	Command token = cmdPACK(cmdZONE_TARGETS, 0, 0, 0);
+	Command moved[NUM_ZONES];
+	unsigned char dirty;
+	unsigned portBASE_TYPE uxNeeded;
+	portBASE_TYPE xSendToken = pdFALSE;
+	portBASE_TYPE xReturn = pdPASS;
+	unsigned portBASE_TYPE zone = cmdIDENTIFIER(cmd);
+
+	/* Logged when queued; the I2C writes it leads to show when it was applied */
+	vEvLogRecord(evlogCOMMAND, cmd >> 8);
+
+	if (((cmdACTION(cmd) == cmdSWITCH) || (cmdACTION(cmd) == cmdDIM)) && (zone < NUM_ZONES)) {
+		portENTER_CRITICAL();
+		ulPosted++;
+		if (ucDirty & (1 << zone)) {
+			ulReplaced++;
+		}
+		xTargets[zone] = cmd;
+		ucDirty |= 1 << zone;
+		/* Commands already queued wake the task, which then takes
+		the targets */
+		if ((xTokenQueued == pdFALSE) && (uxQueueMessagesWaiting(xCmdQ) == 0)) {
+			xTokenQueued = pdTRUE;
+			xSendToken = pdTRUE;
+		}
+		portEXIT_CRITICAL();
+
+		if ((xSendToken != pdFALSE) && (xQueueSendToBack(xCmdQ, &token, 0) != pdPASS)) {
+			/* Other tasks filled the queue meanwhile; they wake it */
+			portENTER_CRITICAL();
+			xTokenQueued = pdFALSE;
+			portEXIT_CRITICAL();
+		}
+		return pdPASS;
+	}
+
+	/* No other task may post between the targets moved and the command */
+	vTaskSuspendAll();
+	ulPosted++;
+	dirty = ucDirty;
+	uxNeeded = 1;
+	for (zone = 0; zone < NUM_ZONES; zone++) {
+		moved[zone] = xTargets[zone];
+		if (dirty & (1 << zone)) {
+			uxNeeded++;
+		}
+	}
+	if (uxQueueSpacesAvailable(xCmdQ) >= uxNeeded) {
+		/* Only tasks post here, so none of these sends can fail */
+		ucDirty = 0;
+		ulMoved += uxNeeded - 1;
+		for (zone = 0; zone < NUM_ZONES; zone++) {
+			if (dirty & (1 << zone)) {
+				xQueueSendToBack(xCmdQ, &moved[zone], 0);
+			}
+		}
+		xQueueSendToBack(xCmdQ, &cmd, 0);
+	} else {
+		/* Leave the targets dirty; they still apply later */
+		ulRefused++;
+		xReturn = pdFAIL;
+	}
+	xTaskResumeAll();
+
+	return xReturn;
+}
+
+/*
+	xCoalesceTake()
+	- Description: Takes the dirty zone targets; called by the
+	sensors task once it has drained its queue
+	- Parameters: pxTargets - receives the target of each dirty zone
+								pucDirty - receives the dirty zones, bit per zone
+	- Returns: pdPASS, or pdFAIL if the queue has commands again,
+	which must be applied first
+*/
+portBASE_TYPE xCoalesceTake( Command pxTargets[NUM_ZONES], unsigned char *pucDirty ) {
+	unsigned portBASE_TYPE zone;
+	portBASE_TYPE xReturn = pdFAIL;
+
+	portENTER_CRITICAL();
+	if (uxQueueMessagesWaiting(xCmdQ) == 0) {
+		for (zone = 0; zone < NUM_ZONES; zone++) {
+			pxTargets[zone] = xTargets[zone];
+		}
+		*pucDirty = ucDirty;
+		ucDirty = 0;
+		xTokenQueued = pdFALSE;
+		xReturn = pdPASS;
+	}
+	portEXIT_CRITICAL();
+
+	return xReturn;
+}
+
+/*
+	vCoalescePrintStats()
+	- Description: Prints the coalescing statistics on the console
+	- Parameters: N/A
+*/
+void vCoalescePrintStats( void ) {
+	unsigned long ulCopy[4];
+
+	portENTER_CRITICAL();
+	ulCopy[0] = ulPosted;
+	ulCopy[1] = ulReplaced;
+	ulCopy[2] = ulMoved;
+	ulCopy[3] = ulRefused;
+	portEXIT_CRITICAL();
+
+	printf("Coalesce: %lu posted, %lu replaced, %lu moved to the queue, %lu refused (queue full)\r\n",
+		ulCopy[0], ulCopy[1], ulCopy[2], ulCopy[3]);
+}
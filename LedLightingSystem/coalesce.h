@@ -0,0 +1,14 @@
+#ifndef COALESCE_H
+#define COALESCE_H
+
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "commands.h"
+#include "zones.h"
+
+void vCoalesceInit( xQueueHandle xQueue );
+portBASE_TYPE xCoalescePost( Command cmd );
+portBASE_TYPE xCoalesceTake( Command pxTargets[NUM_ZONES], unsigned char *pucDirty );
+void vCoalescePrintStats( void );
+
+#endif
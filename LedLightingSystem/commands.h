@@ -3,13 +3,46 @@
 
 enum P1_CMDS {LED_OFF, LED_ON};
 
-typedef struct Command
-{
-  int value;
-	int identifier;
-	int action;
-	int dimValue;
-	unsigned char state;
-} Command;
+/*
+	A command is packed into one 32-bit word, so it is copied through
+	a queue as a single word:
+
+		bits 31-24	action (a SensorsAction or LcdAction)
+		bits 23-16	identifier (button, zone)
+		bits 15-8	value
+		bits 7-0	state byte
+
+	Fields an action does not use are zero.
+*/
+typedef unsigned long Command;
+
+/* Actions of commands sent to the sensors task (xFromUIQ) */
+typedef enum SensorsAction {
+	cmdSWITCH = 0,				/* identifier: button, value: LED_OFF / LED_ON */
+	cmdDIM = 1,					/* identifier: button, value: 2 bright / 4 low */
+	cmdPRESET_SAVE = 2,			/* value: preset (0 or 1) */
+	cmdPRESET_RECALL = 3,		/* value: preset (0 or 1) */
+	cmdZONE_VACATED = 4,		/* identifier: zone, value: occupancy stage */
+	cmdZONE_TARGETS = 5			/* zone commands are waiting in coalesce.c */
+} SensorsAction;
+
+/* Actions of commands sent to the LCD task (xToLCDQueue) */
+typedef enum LcdAction {
+	cmdLCD_SHUTDOWN = 3,		/* fire alarm on: clear the UI */
+	cmdLCD_REFLECT = 4,			/* state: zones to show */
+	cmdLCD_FIRE_PHASE1 = 5,		/* fire alarm flash, first colours */
+	cmdLCD_FIRE_PHASE2 = 6,		/* fire alarm flash, second colours */
+	cmdLCD_FIRE_OFF = 7			/* fire alarm off */
+} LcdAction;
+
+/* Action of a command that does nothing (e.g. a touch off every widget) */
+#define cmdNONE					0xFF
+
+/* Encode / decode */
+#define cmdPACK( action, identifier, value, state )		( ( Command ) ( ( ( ( unsigned long ) ( action ) & 0xFF ) << 24 ) | ( ( ( unsigned long ) ( identifier ) & 0xFF ) << 16 ) | ( ( ( unsigned long ) ( value ) & 0xFF ) << 8 ) | ( ( unsigned long ) ( state ) & 0xFF ) ) )
+#define cmdACTION( cmd )		( ( unsigned char ) ( ( cmd ) >> 24 ) )
+#define cmdIDENTIFIER( cmd )	( ( unsigned char ) ( ( cmd ) >> 16 ) )
+#define cmdVALUE( cmd )			( ( unsigned char ) ( ( cmd ) >> 8 ) )
+#define cmdSTATE( cmd )			( ( unsigned char ) ( cmd ) )
 
 #endif /* COMMANDS_H */
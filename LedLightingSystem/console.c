@@ -6,10 +6,21 @@
 #include "task.h"
 #include "serial.h"
 #include "console.h"
+#include "i2c.h"
+#include "pca9532.h"
+#include "evlog.h"
+#include "timerstats.h"
+#include "wheel.h"
+#include "strobe.h"
+#include "bus.h"
+#include "fanout.h"
+#include "ring.h"
+#include "coalesce.h"
 
 #define consoleSTACK_SIZE			( ( unsigned portBASE_TYPE ) 256 )
 #define consoleBUFFER_LEN			( ( unsigned portBASE_TYPE ) 256 )
 #define consoleMAX_DELAY			( ( portTickType ) 1000 )
+#define consoleLINE_LEN				( ( unsigned portBASE_TYPE ) 16 )
 
 /* Handle to the com port used by the console. */
 static xComPortHandle xPort;
@@ -20,6 +31,33 @@ static void vConsoleTask( void *pvParameters );
 /* Console prompt */
 const char *pcPrompt = "Command> ";
 
+/* Diagnostic commands understood at the prompt */
+typedef struct ConsoleCommand {
+	const char *pcName;
+	void (*pxHandler)( void );
+} ConsoleCommand;
+
+static const ConsoleCommand xCommands[] = {
+	{ "i2c", vI2CPrintStats },
+	{ "pca", vPCA9532PrintStats },
+	{ "log", vEvLogDump },
+	{ "timers", vTimerStatsPrint },
+	{ "tbatch", vTimerStatsBatchTest },
+	{ "strobe", vStrobePrintStats },
+	{ "bus", vBusPrintStats },
+	{ "pool", vFanOutPrintStats },
+	{ "coalesce", vCoalescePrintStats },
+#if wheelBENCHMARK == 1
+	{ "wheel", vWheelBenchmark },
+#endif
+#if ringBENCHMARK == 1
+	{ "ring", vRingBenchmark },
+#endif
+	{ NULL, NULL }
+};
+
+static void prvRunCommand( const char *pcLine );
+
 void vStartConsole( unsigned portBASE_TYPE uxPriority, unsigned long ulBaudRate)
 {
 	/* Initialise the com port. */
@@ -39,6 +77,8 @@ xComPortHandle xConsolePortHandle(void)
 static portTASK_FUNCTION( vConsoleTask, pvParameters )
 {
 	char cRxChar;
+	char cLine[consoleLINE_LEN];
+	unsigned portBASE_TYPE uxLength;
 
 	/* Just to stop compiler warnings. */
 	( void ) pvParameters;
@@ -49,6 +89,7 @@ static portTASK_FUNCTION( vConsoleTask, pvParameters )
 		vSerialPutString(xPort, pcPrompt, strlen((const char *)pcPrompt));
 
 		cRxChar = 0;
+		uxLength = 0;
 
 		while (cRxChar != '\r')
 		{
@@ -62,6 +103,27 @@ static portTASK_FUNCTION( vConsoleTask, pvParameters )
 			{
 				xSerialPutChar(xPort, '\n', consoleMAX_DELAY);
 			}
+			else if (uxLength < consoleLINE_LEN - 1)
+			{
+				cLine[uxLength++] = cRxChar;
+			}
+		}
+
+		cLine[uxLength] = '\0';
+		prvRunCommand(cLine);
+	}
+}
+
+static void prvRunCommand( const char *pcLine )
+{
+	const ConsoleCommand *pxCommand;
+
+	for (pxCommand = xCommands; pxCommand->pcName != NULL; pxCommand++)
+	{
+		if (strcmp(pcLine, pxCommand->pcName) == 0)
+		{
+			pxCommand->pxHandler();
+			return;
 		}
 	}
 }
@@ -49,7 +49,7 @@ static portTASK_FUNCTION( vConsumerTask, pvParameters )
 	    xQueueReceive(xCmdQ, &cmd, portMAX_DELAY);
 
 	    /* Execute command */
-	    switch (cmd.value)
+	    switch (cmdVALUE(cmd))
 	    {
 	        case LED_ON:
                 FIO2SET1 = P210BIT;
@@ -0,0 +1,94 @@
+/*
+	Parallel input debouncer. Every input of every expander has a
+	two bit counter, stored "vertically": bit n of ulCount0 and
+	ulCount1 form the counter of input n, so one word of logical
+	operations steps 32 counters at once. Two expanders share a
+	word. A counter restarts whenever its input agrees with the
+	debounced state and the state flips once the input has
+	disagreed for debounceSAMPLES polls in a row.
+
+	Wesley Fung (fungw@tcd.ie)
+*/
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "debounce.h"
+#include "evlog.h"
+
+/* 16 inputs per expander, two expanders per word */
+#define debounceNUM_WORDS		( ( PCA9532_NUM_DEVICES + 1 ) / 2 )
+#define debounceWORD( dev )		( ( dev ) / 2 )
+#define debounceSHIFT( dev )	( ( ( dev ) % 2 ) * 16 )
+
+static unsigned long ulSample[debounceNUM_WORDS];
+static unsigned long ulState[debounceNUM_WORDS];
+static unsigned long ulCount0[debounceNUM_WORDS];
+static unsigned long ulCount1[debounceNUM_WORDS];
+
+/*
+	vDebounceInit()
+	- Description: Starts with every input inactive and settled
+	- Parameters: N/A
+*/
+void vDebounceInit( void ) {
+	unsigned portBASE_TYPE i;
+
+	for (i = 0; i < debounceNUM_WORDS; i++) {
+		ulSample[i] = 0;
+		ulState[i] = 0;
+		ulCount0[i] = ~0UL;
+		ulCount1[i] = ~0UL;
+	}
+}
+
+/*
+	vDebounceSample()
+	- Description: Records the raw inputs of one expander for the
+	next update
+	- Parameters: dev - device index
+								usActive - inputs, 1 = active
+*/
+void vDebounceSample( unsigned portBASE_TYPE dev, unsigned short usActive ) {
+	unsigned long ulMask = 0xFFFFUL << debounceSHIFT(dev);
+
+	ulSample[debounceWORD(dev)] = (ulSample[debounceWORD(dev)] & ~ulMask) | ((unsigned long) usActive << debounceSHIFT(dev));
+}
+
+/*
+	xDebounceUpdate()
+	- Description: Steps every counter by one poll and reports the
+	inputs whose debounced state changed
+	- Parameters: pxEdges - receives the edges, state and time
+	- Returns: pdTRUE if any input changed state
+*/
+portBASE_TYPE xDebounceUpdate( DebounceEdges *pxEdges ) {
+	unsigned long ulDelta, ulToggle;
+	unsigned long ulAnyToggle = 0;
+	unsigned portBASE_TYPE i, dev;
+
+	for (i = 0; i < debounceNUM_WORDS; i++) {
+		ulDelta = ulSample[i] ^ ulState[i];
+		/* Counters of agreeing inputs reset to 3, the others count down */
+		ulCount0[i] = ~(ulCount0[i] & ulDelta);
+		ulCount1[i] = ulCount0[i] ^ (ulCount1[i] & ulDelta);
+		/* A counter wrapping back to 3 means debounceSAMPLES disagreeing polls */
+		ulToggle = ulDelta & ulCount0[i] & ulCount1[i];
+		ulState[i] ^= ulToggle;
+		ulAnyToggle |= ulToggle;
+
+		for (dev = i * 2; (dev < i * 2 + 2) && (dev < PCA9532_NUM_DEVICES); dev++) {
+			pxEdges->usPressed[dev] = (unsigned short) ((ulToggle & ulState[i]) >> debounceSHIFT(dev));
+			pxEdges->usReleased[dev] = (unsigned short) ((ulToggle & ~ulState[i]) >> debounceSHIFT(dev));
+			pxEdges->usState[dev] = (unsigned short) (ulState[i] >> debounceSHIFT(dev));
+			pxEdges->usBouncing[dev] = (unsigned short) ((ulDelta & ~ulToggle) >> debounceSHIFT(dev));
+			if (pxEdges->usPressed[dev] != 0) {
+				vEvLogRecord(evlogBUTTON_PRESS, ((unsigned long) dev << 16) | pxEdges->usPressed[dev]);
+			}
+			if (pxEdges->usReleased[dev] != 0) {
+				vEvLogRecord(evlogBUTTON_RELEASE, ((unsigned long) dev << 16) | pxEdges->usReleased[dev]);
+			}
+		}
+	}
+	pxEdges->xTime = xTaskGetTickCount();
+	return (ulAnyToggle != 0) ? pdTRUE : pdFALSE;
+}
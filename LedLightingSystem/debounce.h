@@ -0,0 +1,23 @@
+#ifndef DEBOUNCE_H
+#define DEBOUNCE_H
+
+#include "FreeRTOS.h"
+#include "pca9532.h"
+
+/* Polls an input must disagree for to change (fixed by the 2-bit counters) */
+#define debounceSAMPLES			4
+
+/* Debounced edges of every expander input, found in one update */
+typedef struct DebounceEdges {
+	unsigned short usPressed[PCA9532_NUM_DEVICES];	/* became active */
+	unsigned short usReleased[PCA9532_NUM_DEVICES];	/* became inactive */
+	unsigned short usState[PCA9532_NUM_DEVICES];	/* debounced state */
+	unsigned short usBouncing[PCA9532_NUM_DEVICES];	/* still settling */
+	portTickType xTime;			/* tick of the update */
+} DebounceEdges;
+
+void vDebounceInit( void );
+void vDebounceSample( unsigned portBASE_TYPE dev, unsigned short usActive );
+portBASE_TYPE xDebounceUpdate( DebounceEdges *pxEdges );
+
+#endif
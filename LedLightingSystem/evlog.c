@@ -0,0 +1,187 @@
+/*
+	Event log. A ring of the last evlogNUM_ENTRIES events (button
+	edges, touches, commands as they are queued, I2C writes) per
+	writer, each a tick count and a type/argument word, for working
+	out afterwards what the system saw. Interrupts are one writer
+	(they do not nest on this port) and each task that records is
+	another, taking a writer the first time it records.
+
+	Recording is lock-free and never blocks. Only its writer moves a
+	ring's count: the entry is filled first and the count moved after
+	it with a single store, so neither interrupts nor other tasks
+	need to be masked. Old entries are overwritten.
+
+	The "log" console command dumps the rings in binary, merged into
+	one list oldest entry first; tools/evlog.py decodes a capture of
+	it. Dump layout, little-endian:
+		"EVLG", u16 entry count, u16 ticks per second,
+		then per entry: u32 tick, u32 type << 24 | arg
+
+	Wesley Fung (fungw@tcd.ie)
+*/
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "serial.h"
+#include "console.h"
+#include "evlog.h"
+
+#define evlogINDEX_MASK			( evlogNUM_ENTRIES - 1 )
+#define evlogPUT_DELAY			( ( portTickType ) 1000 )
+
+/* Stops the compiler moving the entry stores past the count */
+#if defined( __CC_ARM )
+	#define evlogBARRIER()		__memory_changed()
+#else
+	#define evlogBARRIER()		__asm volatile ( "" ::: "memory" )
+#endif
+
+typedef struct EvLogEntry {
+	portTickType xTime;
+	unsigned long ulEvent;
+} EvLogEntry;
+
+typedef struct EvLogWriter {
+	xTaskHandle xTask;				/* NULL for the interrupts */
+	/* Total entries ever recorded; the next slot is ulHead & evlogINDEX_MASK */
+	volatile unsigned long ulHead;
+	EvLogEntry xLog[evlogNUM_ENTRIES];
+} EvLogWriter;
+
+/* Writer 0 is the interrupts */
+static EvLogWriter xWriters[evlogNUM_WRITERS];
+static volatile unsigned portBASE_TYPE uxWriters = 1;
+
+/*
+	prvRecord()
+	- Description: Fills the next slot of a writer; only that writer
+	may call it
+	- Parameters: pxWriter - writer
+								xTime - tick of the event
+								type - evlog... type
+								arg - 24 bit argument
+*/
+static void prvRecord( EvLogWriter *pxWriter, portTickType xTime, unsigned char type, unsigned long arg ) {
+	unsigned long ulHead = pxWriter->ulHead;
+	EvLogEntry *pxEntry = &pxWriter->xLog[ulHead & evlogINDEX_MASK];
+
+	pxEntry->xTime = xTime;
+	pxEntry->ulEvent = ((unsigned long) type << 24) | (arg & evlogARG_MASK);
+	evlogBARRIER();
+	pxWriter->ulHead = ulHead + 1;
+}
+
+/*
+	prvTaskWriter()
+	- Description: Finds the writer of the calling task, taking a
+	free one the first time
+	- Parameters: N/A
+	- Returns: the writer, or NULL if every writer is taken
+*/
+static EvLogWriter *prvTaskWriter( void ) {
+	xTaskHandle xTask = xTaskGetCurrentTaskHandle();
+	EvLogWriter *pxWriter = NULL;
+	unsigned portBASE_TYPE i;
+
+	for (i = 1; i < uxWriters; i++) {
+		if (xWriters[i].xTask == xTask) {
+			return &xWriters[i];
+		}
+	}
+
+	/* Once per task */
+	portENTER_CRITICAL();
+	if (uxWriters < evlogNUM_WRITERS) {
+		pxWriter = &xWriters[uxWriters];
+		pxWriter->xTask = xTask;
+		uxWriters++;
+	}
+	portEXIT_CRITICAL();
+	return pxWriter;
+}
+
+/*
+	vEvLogRecord()
+	- Description: Records an event from a task
+	- Parameters: type - evlog... type
+								arg - 24 bit argument
+*/
+void vEvLogRecord( unsigned char type, unsigned long arg ) {
+	EvLogWriter *pxWriter = prvTaskWriter();
+
+	if (pxWriter != NULL) {
+		prvRecord(pxWriter, xTaskGetTickCount(), type, arg);
+	}
+}
+
+/*
+	vEvLogRecordFromISR()
+	- Description: Records an event from an ISR
+	- Parameters: type - evlog... type
+								arg - 24 bit argument
+*/
+void vEvLogRecordFromISR( unsigned char type, unsigned long arg ) {
+	prvRecord(&xWriters[0], xTaskGetTickCountFromISR(), type, arg);
+}
+
+/*
+	prvPutWord()
+	- Description: Sends the low bytes of a word, least significant
+	first
+	- Parameters: xPort - console port
+								ulWord - value
+								uxBytes - bytes to send
+*/
+static void prvPutWord( xComPortHandle xPort, unsigned long ulWord, unsigned portBASE_TYPE uxBytes ) {
+	while (uxBytes-- > 0) {
+		xSerialPutChar(xPort, (char) (ulWord & 0xFF), evlogPUT_DELAY);
+		ulWord >>= 8;
+	}
+}
+
+/*
+	vEvLogDump()
+	- Description: Sends the log to the console in binary, the rings
+	of all writers merged by tick. Entries recorded while the dump is
+	in progress may overwrite the oldest ones before they are sent.
+	- Parameters: N/A
+*/
+void vEvLogDump( void ) {
+	xComPortHandle xPort = xConsolePortHandle();
+	unsigned long ulNext[evlogNUM_WRITERS], ulEnd[evlogNUM_WRITERS];
+	unsigned long ulCount = 0, ulHead;
+	unsigned portBASE_TYPE uxCount = uxWriters;
+	unsigned portBASE_TYPE i, uxOldest;
+	EvLogEntry xEntry, xOldest;
+	const char *pcMagic = evlogDUMP_MAGIC;
+
+	for (i = 0; i < uxCount; i++) {
+		ulHead = xWriters[i].ulHead;
+		ulEnd[i] = ulHead;
+		ulNext[i] = (ulHead < evlogNUM_ENTRIES) ? 0 : ulHead - evlogNUM_ENTRIES;
+		ulCount += ulEnd[i] - ulNext[i];
+	}
+
+	while (*pcMagic != '\0') {
+		xSerialPutChar(xPort, *pcMagic++, evlogPUT_DELAY);
+	}
+	prvPutWord(xPort, ulCount, 2);
+	prvPutWord(xPort, configTICK_RATE_HZ, 2);
+
+	while (ulCount-- > 0) {
+		uxOldest = evlogNUM_WRITERS;
+		for (i = 0; i < uxCount; i++) {
+			if (ulNext[i] == ulEnd[i]) {
+				continue;
+			}
+			xEntry = xWriters[i].xLog[ulNext[i] & evlogINDEX_MASK];
+			if ((uxOldest == evlogNUM_WRITERS) || ((long) (xEntry.xTime - xOldest.xTime) < 0)) {
+				uxOldest = i;
+				xOldest = xEntry;
+			}
+		}
+		ulNext[uxOldest]++;
+		prvPutWord(xPort, xOldest.xTime, 4);
+		prvPutWord(xPort, xOldest.ulEvent, 4);
+	}
+}
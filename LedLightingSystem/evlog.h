@@ -0,0 +1,28 @@
+#ifndef EVLOG_H
+#define EVLOG_H
+
+#include "FreeRTOS.h"
+
+/* Entries kept per writer; a power of two. Each costs two words of
+RAM. Interrupts are one writer and each task recording is another. */
+#define evlogNUM_ENTRIES		64
+#define evlogNUM_WRITERS		6
+
+/* Event types (top byte of an entry's second word) */
+#define evlogBUTTON_PRESS		1	/* arg: device << 16 | inputs */
+#define evlogBUTTON_RELEASE		2	/* arg: device << 16 | inputs */
+#define evlogTOUCH				3	/* arg: x << 12 | y */
+#define evlogCOMMAND			4	/* arg: action << 16 | identifier << 8 | value */
+#define evlogI2C_WRITE			5	/* arg: device << 16 | register << 8 | length */
+
+/* Arguments are 24 bits */
+#define evlogARG_MASK			( ( unsigned long ) 0x00FFFFFF )
+
+/* First bytes of a dump */
+#define evlogDUMP_MAGIC			"EVLG"
+
+void vEvLogRecord( unsigned char type, unsigned long arg );
+void vEvLogRecordFromISR( unsigned char type, unsigned long arg );
+void vEvLogDump( void );
+
+#endif
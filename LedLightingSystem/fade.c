@@ -0,0 +1,415 @@
+/*
+	Fade engine. Zones fade between brightness levels by ramping
+	the duty cycle of one of the two PWM banks of their expander
+	while the zone's LED selector points at that bank. Zones are
+	moved between banks as needed: a zone fading on its own takes a
+	free bank, zones starting the same fade at the same level share
+	one, and a bank is released as soon as its zones have reached
+	fully off or fully on (plain OFF/ON selectors need no bank).
+
+	Levels are perceptual and go through a gamma table, so a linear
+	ramp looks linear. Steps only touch the PWM register of the
+	bank, are never closer than fadeMIN_STEP_MS and are skipped when
+	the duty byte would not change.
+
+	Wesley Fung (fungw@tcd.ie)
+*/
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "pca9532.h"
+#include "zones.h"
+#include "fade.h"
+
+#define fadeNO_BANK				( -1 )
+
+typedef struct FadeBank {
+	unsigned char ucLevel;		/* level the bank is showing now */
+	unsigned char ucStart;		/* level the current ramp started at */
+	unsigned char ucTarget;		/* level the current ramp ends at */
+	portTickType xStartTime;
+	portTickType xDuration;
+	portTickType xStep;			/* ticks between steps of this ramp */
+	portTickType xNextStep;
+	unsigned short usMembers;	/* bit n set when zone n uses the bank */
+} FadeBank;
+
+/* Perceptual level to PWM duty, gamma 2.2 */
+static const unsigned char ucGamma[256] = {
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   1,
+	  1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   2,   2,   2,   2,   2,   2,
+	  3,   3,   3,   3,   3,   4,   4,   4,   4,   5,   5,   5,   5,   6,   6,   6,
+	  6,   7,   7,   7,   8,   8,   8,   9,   9,   9,  10,  10,  11,  11,  11,  12,
+	 12,  13,  13,  13,  14,  14,  15,  15,  16,  16,  17,  17,  18,  18,  19,  19,
+	 20,  20,  21,  22,  22,  23,  23,  24,  25,  25,  26,  26,  27,  28,  28,  29,
+	 30,  30,  31,  32,  33,  33,  34,  35,  35,  36,  37,  38,  39,  39,  40,  41,
+	 42,  43,  43,  44,  45,  46,  47,  48,  49,  49,  50,  51,  52,  53,  54,  55,
+	 56,  57,  58,  59,  60,  61,  62,  63,  64,  65,  66,  67,  68,  69,  70,  71,
+	 73,  74,  75,  76,  77,  78,  79,  81,  82,  83,  84,  85,  87,  88,  89,  90,
+	 91,  93,  94,  95,  97,  98,  99, 100, 102, 103, 105, 106, 107, 109, 110, 111,
+	113, 114, 116, 117, 119, 120, 121, 123, 124, 126, 127, 129, 130, 132, 133, 135,
+	137, 138, 140, 141, 143, 145, 146, 148, 149, 151, 153, 154, 156, 158, 159, 161,
+	163, 165, 166, 168, 170, 172, 173, 175, 177, 179, 181, 182, 184, 186, 188, 190,
+	192, 194, 196, 197, 199, 201, 203, 205, 207, 209, 211, 213, 215, 217, 219, 221,
+	223, 225, 227, 229, 231, 234, 236, 238, 240, 242, 244, 246, 248, 251, 253, 255
+};
+
+static FadeBank xBanks[PCA9532_NUM_DEVICES][fadeNUM_BANKS];
+
+/* Bank each zone is on, or fadeNO_BANK when it is plainly OFF/ON */
+static signed char cZoneBank[NUM_ZONES];
+/* Level of zones that are not on a bank */
+static unsigned char ucZoneLevel[NUM_ZONES];
+/* Level each zone is heading to */
+static unsigned char ucZoneTarget[NUM_ZONES];
+
+/* Fades are requested and stepped by the sensors task only; the lock
+keeps ucFadeLevel() safe to call from other tasks */
+static xSemaphoreHandle xFadeLock;
+
+/*
+	prvSetBankLevel()
+	- Description: Shows a level on a bank; stages the PWM register
+	only if the duty byte changes
+	- Parameters: dev - device index
+								bank - bank number
+								level - perceptual level
+*/
+static void prvSetBankLevel( unsigned portBASE_TYPE dev, unsigned portBASE_TYPE bank, unsigned char level ) {
+	FadeBank *pxBank = &xBanks[dev][bank];
+
+	if (ucGamma[level] != ucGamma[pxBank->ucLevel]) {
+		vPCA9532Set(dev, PCA9532_PWM0 + bank * 2, ucGamma[level]);
+	}
+	pxBank->ucLevel = level;
+}
+
+/*
+	prvLeave()
+	- Description: Takes a zone off its bank (if any). The zone
+	keeps the bank's current level until it is placed elsewhere.
+	- Parameters: zone - zone number
+*/
+static void prvLeave( unsigned portBASE_TYPE zone ) {
+	FadeBank *pxBank;
+
+	if (cZoneBank[zone] != fadeNO_BANK) {
+		pxBank = &xBanks[uxZoneDevice(zone)][cZoneBank[zone]];
+		pxBank->usMembers &= ~(1 << zone);
+		ucZoneLevel[zone] = pxBank->ucLevel;
+		cZoneBank[zone] = fadeNO_BANK;
+	}
+}
+
+/*
+	prvJoin()
+	- Description: Points a zone's selector at a bank
+	- Parameters: zone - zone number
+								bank - bank number on the zone's expander
+*/
+static void prvJoin( unsigned portBASE_TYPE zone, unsigned portBASE_TYPE bank ) {
+	prvLeave(zone);
+	xBanks[uxZoneDevice(zone)][bank].usMembers |= (1 << zone);
+	cZoneBank[zone] = bank;
+	vZoneSet(zone, ZONE_PWM0 + bank);
+}
+
+/*
+	prvPark()
+	- Description: Sets a zone plainly off or on, freeing its bank
+	- Parameters: zone - zone number
+								level - fadeLEVEL_OFF or fadeLEVEL_FULL
+*/
+static void prvPark( unsigned portBASE_TYPE zone, unsigned char level ) {
+	prvLeave(zone);
+	ucZoneLevel[zone] = level;
+	vZoneSet(zone, (level == fadeLEVEL_OFF) ? ZONE_OFF : ZONE_ON);
+}
+
+/*
+	prvCurrentLevel()
+	- Description: Level a zone is showing now
+	- Parameters: zone - zone number
+*/
+static unsigned char prvCurrentLevel( unsigned portBASE_TYPE zone ) {
+	if (cZoneBank[zone] != fadeNO_BANK) {
+		return xBanks[uxZoneDevice(zone)][cZoneBank[zone]].ucLevel;
+	}
+	return ucZoneLevel[zone];
+}
+
+/*
+	prvHeadingLevel()
+	- Description: Level a zone will end up at, which differs from
+	the one asked for when it had to share a bank
+	- Parameters: zone - zone number
+*/
+static unsigned char prvHeadingLevel( unsigned portBASE_TYPE zone ) {
+	if (cZoneBank[zone] != fadeNO_BANK) {
+		return xBanks[uxZoneDevice(zone)][cZoneBank[zone]].ucTarget;
+	}
+	return ucZoneLevel[zone];
+}
+
+/*
+	prvFreeBank()
+	- Description: Finds a bank on an expander that no zone uses
+	- Parameters: dev - device index
+	- Returns: bank number, or fadeNO_BANK if both are in use
+*/
+static signed char prvFreeBank( unsigned portBASE_TYPE dev ) {
+	unsigned portBASE_TYPE bank;
+
+	for (bank = 0; bank < fadeNUM_BANKS; bank++) {
+		if (xBanks[dev][bank].usMembers == 0) {
+			return bank;
+		}
+	}
+	return fadeNO_BANK;
+}
+
+/*
+	prvPlace()
+	- Description: Moves a zone to a level at once. Off and full
+	need no bank; other levels join a bank already showing the
+	level, else take a free bank, else (both banks busy) share the
+	bank closest to the level.
+	- Parameters: zone - zone number
+								level - perceptual level
+*/
+static void prvPlace( unsigned portBASE_TYPE zone, unsigned char level ) {
+	unsigned portBASE_TYPE dev = uxZoneDevice(zone);
+	unsigned portBASE_TYPE bank;
+	FadeBank *pxBank;
+	signed char cBest = fadeNO_BANK;
+	int distance, bestDistance = 256;
+
+	if ((level == fadeLEVEL_OFF) || (level == fadeLEVEL_FULL)) {
+		prvPark(zone, level);
+		return;
+	}
+
+	/* Alone on a bank: just move the bank */
+	if ((cZoneBank[zone] != fadeNO_BANK) && (xBanks[dev][cZoneBank[zone]].usMembers == (1 << zone))) {
+		pxBank = &xBanks[dev][cZoneBank[zone]];
+		prvSetBankLevel(dev, cZoneBank[zone], level);
+		pxBank->ucTarget = level;
+		return;
+	}
+
+	for (bank = 0; bank < fadeNUM_BANKS; bank++) {
+		pxBank = &xBanks[dev][bank];
+		if (pxBank->usMembers == 0) {
+			continue;
+		}
+		distance = (int) pxBank->ucTarget - (int) level;
+		if (distance < 0) {
+			distance = -distance;
+		}
+		if ((pxBank->ucLevel == pxBank->ucTarget) && (distance == 0)) {
+			prvJoin(zone, bank);
+			return;
+		}
+		if (distance < bestDistance) {
+			bestDistance = distance;
+			cBest = bank;
+		}
+	}
+
+	prvLeave(zone);
+	bank = prvFreeBank(dev);
+	if (bank != ( unsigned portBASE_TYPE ) fadeNO_BANK) {
+		prvSetBankLevel(dev, bank, level);
+		xBanks[dev][bank].ucTarget = level;
+		prvJoin(zone, bank);
+	} else {
+		prvJoin(zone, cBest);
+	}
+}
+
+/*
+	vFadeInit()
+	- Description: Programs both prescalers and the starting levels
+	of both banks on every expander, one transaction per expander.
+	Must be called before any other function in this file.
+	- Parameters: psc - prescaler for both banks
+								level0 - starting level of the PWM0 banks
+								level1 - starting level of the PWM1 banks
+*/
+void vFadeInit( unsigned char psc, unsigned char level0, unsigned char level1 ) {
+	PCA9532Scene scene;
+	unsigned portBASE_TYPE dev, zone;
+	unsigned char i;
+
+	if (xFadeLock == NULL) {
+		vSemaphoreCreateBinary(xFadeLock);
+	}
+
+	scene.psc0 = psc;
+	scene.pwm0 = ucGamma[level0];
+	scene.psc1 = psc;
+	scene.pwm1 = ucGamma[level1];
+	for (dev = 0; dev < PCA9532_NUM_DEVICES; dev++) {
+		for (i = 0; i < 4; i++) {
+			scene.ls[i] = ucPCA9532Get(dev, PCA9532_LS0 + i);
+		}
+		xPCA9532ApplyScene(dev, &scene);
+		xBanks[dev][0].ucLevel = xBanks[dev][0].ucTarget = level0;
+		xBanks[dev][1].ucLevel = xBanks[dev][1].ucTarget = level1;
+	}
+	for (zone = 0; zone < NUM_ZONES; zone++) {
+		cZoneBank[zone] = fadeNO_BANK;
+	}
+}
+
+/*
+	vFadeZone()
+	- Description: Starts a zone fading from its current level to a
+	new one. The changes are only staged; the caller flushes them
+	(the first step is staged straight away). If both banks of the
+	expander are busy with other zones the change is made at once.
+	- Parameters: zone - zone number
+								level - perceptual level to reach
+								duration - ticks the fade should take (0 = at once)
+*/
+void vFadeZone( unsigned portBASE_TYPE zone, unsigned char level, portTickType duration ) {
+	unsigned portBASE_TYPE dev = uxZoneDevice(zone);
+	unsigned portBASE_TYPE bank;
+	unsigned char current;
+	FadeBank *pxBank;
+	signed char cBank = fadeNO_BANK;
+	int delta;
+
+	xSemaphoreTake(xFadeLock, portMAX_DELAY);
+	current = prvCurrentLevel(zone);
+	if ((level == ucZoneTarget[zone]) && ((duration != 0) || (current == level))) {
+		/* Already there or on the way */
+		xSemaphoreGive(xFadeLock);
+		return;
+	}
+
+	if ((duration == 0) || (current == level)) {
+		prvPlace(zone, level);
+		ucZoneTarget[zone] = prvHeadingLevel(zone);
+		xSemaphoreGive(xFadeLock);
+		return;
+	}
+
+	if ((cZoneBank[zone] != fadeNO_BANK) && (xBanks[dev][cZoneBank[zone]].usMembers == (1 << zone))) {
+		cBank = cZoneBank[zone];
+	} else {
+		/* Share a ramp that is at the same level heading the same way */
+		for (bank = 0; bank < fadeNUM_BANKS; bank++) {
+			pxBank = &xBanks[dev][bank];
+			if ((pxBank->usMembers != 0) && (pxBank->ucTarget == level) && (pxBank->ucLevel == current)) {
+				prvJoin(zone, bank);
+				ucZoneTarget[zone] = level;
+				xSemaphoreGive(xFadeLock);
+				return;
+			}
+		}
+		prvLeave(zone);
+		cBank = prvFreeBank(dev);
+		if (cBank == fadeNO_BANK) {
+			prvPlace(zone, level);
+			ucZoneTarget[zone] = prvHeadingLevel(zone);
+			xSemaphoreGive(xFadeLock);
+			return;
+		}
+		prvSetBankLevel(dev, cBank, current);
+		prvJoin(zone, cBank);
+	}
+
+	pxBank = &xBanks[dev][cBank];
+	delta = (int) level - (int) current;
+	if (delta < 0) {
+		delta = -delta;
+	}
+	pxBank->ucStart = current;
+	pxBank->ucTarget = level;
+	pxBank->xStartTime = xTaskGetTickCount();
+	pxBank->xDuration = duration;
+	pxBank->xStep = duration / delta;
+	if (pxBank->xStep < fadeMIN_STEP_MS / portTICK_RATE_MS) {
+		pxBank->xStep = fadeMIN_STEP_MS / portTICK_RATE_MS;
+	}
+	pxBank->xNextStep = pxBank->xStartTime + pxBank->xStep;
+	ucZoneTarget[zone] = level;
+	xSemaphoreGive(xFadeLock);
+}
+
+/*
+	ucFadeLevel()
+	- Description: Level a zone is showing now
+	- Parameters: zone - zone number
+*/
+unsigned char ucFadeLevel( unsigned portBASE_TYPE zone ) {
+	unsigned char level;
+
+	xSemaphoreTake(xFadeLock, portMAX_DELAY);
+	level = prvCurrentLevel(zone);
+	xSemaphoreGive(xFadeLock);
+	return level;
+}
+
+/*
+	xFadeService()
+	- Description: Advances every ramp that is due a step and stages
+	the new duty cycles; the caller flushes. Banks that have
+	reached off or full hand their zones back to plain OFF/ON
+	selectors and become free.
+	- Parameters: N/A
+	- Returns: ticks until the next step is due, portMAX_DELAY if
+	nothing is fading
+*/
+portTickType xFadeService( void ) {
+	portTickType xNow, xElapsed, xWait = portMAX_DELAY;
+	unsigned portBASE_TYPE dev, bank, zone;
+	FadeBank *pxBank;
+	long level;
+
+	xSemaphoreTake(xFadeLock, portMAX_DELAY);
+	xNow = xTaskGetTickCount();
+	for (dev = 0; dev < PCA9532_NUM_DEVICES; dev++) {
+		for (bank = 0; bank < fadeNUM_BANKS; bank++) {
+			pxBank = &xBanks[dev][bank];
+			if ((pxBank->usMembers == 0) || (pxBank->ucLevel == pxBank->ucTarget)) {
+				continue;
+			}
+			if ((long) (xNow - pxBank->xNextStep) < 0) {
+				/* Not due yet */
+				if ((portTickType) (pxBank->xNextStep - xNow) < xWait) {
+					xWait = pxBank->xNextStep - xNow;
+				}
+				continue;
+			}
+
+			xElapsed = xNow - pxBank->xStartTime;
+			if (xElapsed >= pxBank->xDuration) {
+				level = pxBank->ucTarget;
+			} else {
+				level = (long) pxBank->ucStart
+					+ ((long) pxBank->ucTarget - (long) pxBank->ucStart) * (long) xElapsed / (long) pxBank->xDuration;
+			}
+			prvSetBankLevel(dev, bank, (unsigned char) level);
+
+			if (pxBank->ucLevel == pxBank->ucTarget) {
+				if ((pxBank->ucTarget == fadeLEVEL_OFF) || (pxBank->ucTarget == fadeLEVEL_FULL)) {
+					for (zone = 0; zone < NUM_ZONES; zone++) {
+						if (pxBank->usMembers & (1 << zone)) {
+							prvPark(zone, pxBank->ucTarget);
+						}
+					}
+				}
+				continue;
+			}
+			pxBank->xNextStep = xNow + pxBank->xStep;
+			if (pxBank->xStep < xWait) {
+				xWait = pxBank->xStep;
+			}
+		}
+	}
+	xSemaphoreGive(xFadeLock);
+	return xWait;
+}
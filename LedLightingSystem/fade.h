@@ -0,0 +1,25 @@
+#ifndef FADE_H
+#define FADE_H
+
+#include "FreeRTOS.h"
+
+/* Each PCA9532 has two PWM banks (PWM0/PWM1) */
+#define fadeNUM_BANKS			2
+
+/*
+	Shortest interval between two steps of a ramp (ms). One step is
+	at most one 3-byte burst per expander, so this keeps a fade to
+	well under 1% of the 400 kHz bus.
+*/
+#define fadeMIN_STEP_MS			20
+
+/* Brightness levels are perceptual: 0 is off, 255 is fully on */
+#define fadeLEVEL_OFF			0
+#define fadeLEVEL_FULL			255
+
+void vFadeInit( unsigned char psc, unsigned char level0, unsigned char level1 );
+void vFadeZone( unsigned portBASE_TYPE zone, unsigned char level, portTickType duration );
+unsigned char ucFadeLevel( unsigned portBASE_TYPE zone );
+portTickType xFadeService( void );
+
+#endif
@@ -0,0 +1,99 @@
+/*
+	Pooled fan-out messages. An event posted to several consumers is
+	stored once, in a message taken from a static pool, and each
+	consumer is given a pointer to it; the message counts the
+	consumers that still hold it and goes back to the pool when the
+	last one releases it. Nothing is allocated from the heap and
+	consumer queues carry only pointers.
+
+	Free messages are kept on a stack of pool slots. Slots never used
+	yet are handed out in order first, so the pool needs no
+	initialisation. When every message is in use an allocation fails
+	and is counted; the poster decides what the consumers miss.
+
+	The "pool" console command prints the messages in use, the most
+	ever in use, the allocations and the allocations that found the
+	pool exhausted.
+
+	Wesley Fung (fungw@tcd.ie)
+*/
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include <stdio.h>
+#include "fanout.h"
+
+static FanOutMessage xPool[fanoutPOOL_SIZE];
+static unsigned char ucFree[fanoutPOOL_SIZE];
+static unsigned portBASE_TYPE uxFree;
+static unsigned portBASE_TYPE uxNeverUsed;
+
+/* Statistics */
+static unsigned portBASE_TYPE uxInUse;
+static unsigned portBASE_TYPE uxPeak;
+static unsigned long ulAllocated;
+static unsigned long ulExhausted;
+
+/*
+	pxFanOutAlloc()
+	- Description: Takes a message from the pool; interrupts must be
+	masked
+	- Parameters: xEvent - event the message carries
+								uxRefs - consumers it will be posted to, at least 1
+	- Returns: the message, or NULL if the pool is exhausted
+*/
+FanOutMessage *pxFanOutAlloc( Command xEvent, unsigned portBASE_TYPE uxRefs ) {
+	FanOutMessage *pxMessage;
+
+	if (uxFree != 0) {
+		pxMessage = &xPool[ucFree[--uxFree]];
+	} else if (uxNeverUsed < fanoutPOOL_SIZE) {
+		pxMessage = &xPool[uxNeverUsed];
+		pxMessage->ucIndex = (unsigned char) uxNeverUsed++;
+	} else {
+		ulExhausted++;
+		return NULL;
+	}
+
+	pxMessage->xEvent = xEvent;
+	pxMessage->ucRefs = (unsigned char) uxRefs;
+	ulAllocated++;
+	if (++uxInUse > uxPeak) {
+		uxPeak = uxInUse;
+	}
+	return pxMessage;
+}
+
+/*
+	vFanOutRelease()
+	- Description: A consumer is done with a message; the last one
+	returns it to the pool. Called from a task.
+	- Parameters: pxMessage - from pxFanOutAlloc()
+*/
+void vFanOutRelease( FanOutMessage *pxMessage ) {
+	portENTER_CRITICAL();
+	if (--pxMessage->ucRefs == 0) {
+		ucFree[uxFree++] = pxMessage->ucIndex;
+		uxInUse--;
+	}
+	portEXIT_CRITICAL();
+}
+
+/*
+	vFanOutPrintStats()
+	- Description: Prints the pool occupancy on the console
+	- Parameters: N/A
+*/
+void vFanOutPrintStats( void ) {
+	unsigned long ulCopy[4];
+
+	portENTER_CRITICAL();
+	ulCopy[0] = uxInUse;
+	ulCopy[1] = uxPeak;
+	ulCopy[2] = ulAllocated;
+	ulCopy[3] = ulExhausted;
+	portEXIT_CRITICAL();
+
+	printf("Pool: %lu of %lu messages in use, peak %lu, %lu allocated, %lu exhausted\r\n",
+		ulCopy[0], (unsigned long) fanoutPOOL_SIZE, ulCopy[1], ulCopy[2], ulCopy[3]);
+}
@@ -0,0 +1,25 @@
+#ifndef FANOUT_H
+#define FANOUT_H
+
+#include "FreeRTOS.h"
+#include "commands.h"
+
+/* Messages in the pool; each one is shared by every consumer it is
+posted to */
+#define fanoutPOOL_SIZE			32
+
+/*
+	A pooled message. Consumers get a pointer to it and read xEvent;
+	the message goes back to the pool when the last one releases it.
+*/
+typedef struct FanOutMessage {
+	Command xEvent;
+	unsigned char ucRefs;
+	unsigned char ucIndex;		/* slot in the pool */
+} FanOutMessage;
+
+FanOutMessage *pxFanOutAlloc( Command xEvent, unsigned portBASE_TYPE uxRefs );
+void vFanOutRelease( FanOutMessage *pxMessage );
+void vFanOutPrintStats( void );
+
+#endif
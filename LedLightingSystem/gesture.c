@@ -0,0 +1,226 @@
+/*
+	Button gesture recognition. Every button runs the same small
+	state machine, described by xTransitions[]: each debounced
+	press or release, and each expired deadline, is one lookup that
+	gives the next state, the gesture to report (if any) and the
+	deadline to arm. Deadlines are plain tick values checked when
+	the inputs are polled, so no timers are needed and the cost of
+	a poll without edges does not depend on the number of buttons.
+
+	Presses also drive the key code matcher: an automaton built by
+	tools/keycodes.py (keycodes.c) that follows every code at once,
+	overlaps included, with one table lookup per press.
+
+	Wesley Fung (fungw@tcd.ie)
+*/
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "gesture.h"
+
+/* Buttons: (device, input) of each, in button number order */
+typedef struct ButtonInput {
+	unsigned char device;
+	unsigned char input;
+} ButtonInput;
+
+/* The EA board's four push buttons are inputs 0-3 of expander 0 */
+static const ButtonInput xButtonMap[] = {
+	{ 0, 0 },
+	{ 0, 1 },
+	{ 0, 2 },
+	{ 0, 3 }
+};
+#define gestureNUM_BUTTONS		( sizeof( xButtonMap ) / sizeof( xButtonMap[0] ) )
+#define gestureNO_BUTTON		0xFF
+
+/* Button states */
+#define gsIDLE					0
+#define gsDOWN					1	/* pressed, hold deadline armed */
+#define gsUP					2	/* released, double deadline armed */
+#define gsDOWN2					3	/* second press of a double */
+#define gsHELD					4	/* hold reported, waiting for release */
+#define gsNUM_STATES			5
+
+/* State machine inputs */
+#define giPRESS					0
+#define giRELEASE				1
+#define giDEADLINE				2
+#define giNUM_INPUTS			3
+
+/* Deadlines a transition can arm */
+#define gdNONE					0
+#define gdHOLD					1
+#define gdDOUBLE				2
+
+typedef struct GestureTransition {
+	unsigned char ucNext;
+	unsigned char ucGesture;
+	unsigned char ucDeadline;
+} GestureTransition;
+
+static const GestureTransition xTransitions[gsNUM_STATES][giNUM_INPUTS] = {
+	/*				press								release								deadline */
+	/* IDLE */	{ { gsDOWN, gestureNONE, gdHOLD },		{ gsIDLE, gestureNONE, gdNONE },	{ gsIDLE, gestureNONE, gdNONE } },
+	/* DOWN */	{ { gsDOWN, gestureNONE, gdHOLD },		{ gsUP, gestureNONE, gdDOUBLE },	{ gsHELD, gestureHOLD, gdNONE } },
+	/* UP */	{ { gsDOWN2, gestureDOUBLE, gdNONE },	{ gsUP, gestureNONE, gdDOUBLE },	{ gsIDLE, gesturePRESS, gdNONE } },
+	/* DOWN2 */	{ { gsDOWN2, gestureNONE, gdNONE },		{ gsIDLE, gestureNONE, gdNONE },	{ gsDOWN2, gestureNONE, gdNONE } },
+	/* HELD */	{ { gsHELD, gestureNONE, gdNONE },		{ gsIDLE, gestureNONE, gdNONE },	{ gsHELD, gestureNONE, gdNONE } }
+};
+
+/* Button number of each expander input, or gestureNO_BUTTON */
+static unsigned char ucInputButton[PCA9532_NUM_DEVICES][16];
+/* Inputs of each expander that are buttons */
+static unsigned short usButtonInputs[PCA9532_NUM_DEVICES];
+
+static unsigned char ucState[gestureNUM_BUTTONS];
+static portTickType xDeadline[gestureNUM_BUTTONS];
+/* Bit n set while button n has a deadline armed */
+static unsigned long ulArmed;
+/* Earliest armed deadline */
+static portTickType xNextDeadline;
+
+/* Key code automaton state */
+static unsigned char ucKeyState;
+
+/*
+	prvEmit()
+	- Description: Appends a gesture to the caller's list
+	- Parameters: pxEvents - list
+								puxCount - entries used so far
+								type - gesture type
+								button - button or sequence index
+								xTime - tick
+*/
+static void prvEmit( GestureEvent *pxEvents, unsigned portBASE_TYPE *puxCount, unsigned char type, unsigned char button, portTickType xTime ) {
+	if (*puxCount < gestureMAX_EVENTS) {
+		pxEvents[*puxCount].ucType = type;
+		pxEvents[*puxCount].ucButton = button;
+		pxEvents[*puxCount].xTime = xTime;
+		(*puxCount)++;
+	}
+}
+
+/*
+	prvStep()
+	- Description: Runs one input through a button's state machine
+	- Parameters: button - button number
+								input - giPRESS / giRELEASE / giDEADLINE
+								xTime - tick of the input
+								pxEvents, puxCount - gesture list
+*/
+static void prvStep( unsigned char button, unsigned char input, portTickType xTime, GestureEvent *pxEvents, unsigned portBASE_TYPE *puxCount ) {
+	const GestureTransition *pxT = &xTransitions[ucState[button]][input];
+
+	ucState[button] = pxT->ucNext;
+	if (pxT->ucGesture != gestureNONE) {
+		prvEmit(pxEvents, puxCount, pxT->ucGesture, button, xTime);
+	}
+	if (pxT->ucDeadline == gdNONE) {
+		ulArmed &= ~(1UL << button);
+		return;
+	}
+	xDeadline[button] = xTime + ((pxT->ucDeadline == gdHOLD) ? gestureHOLD_MS : gestureDOUBLE_MS) / portTICK_RATE_MS;
+	if ((ulArmed == 0) || ((long) (xDeadline[button] - xNextDeadline) < 0)) {
+		xNextDeadline = xDeadline[button];
+	}
+	ulArmed |= (1UL << button);
+}
+
+/*
+	prvSequencePress()
+	- Description: Moves the key code automaton on by one press and
+	reports every code that the press completes
+	- Parameters: button - button pressed
+								xTime - tick of the press
+								pxEvents, puxCount - gesture list
+*/
+static void prvSequencePress( unsigned char button, portTickType xTime, GestureEvent *pxEvents, unsigned portBASE_TYPE *puxCount ) {
+	unsigned long ulMatch;
+	unsigned char code;
+
+	/* Buttons outside the codes' alphabet break every code */
+	ucKeyState = (button < keyNUM_KEYS) ? ucKeyNext[ucKeyState][button] : 0;
+	ulMatch = ulKeyMatch[ucKeyState];
+	for (code = 0; ulMatch != 0; code++, ulMatch >>= 1) {
+		if (ulMatch & 1) {
+			prvEmit(pxEvents, puxCount, gestureSEQUENCE, code, xTime);
+		}
+	}
+}
+
+/*
+	vGestureInit()
+	- Description: Resets every button and the key code matcher
+	- Parameters: N/A
+*/
+void vGestureInit( void ) {
+	unsigned portBASE_TYPE dev, i;
+
+	for (dev = 0; dev < PCA9532_NUM_DEVICES; dev++) {
+		usButtonInputs[dev] = 0;
+		for (i = 0; i < 16; i++) {
+			ucInputButton[dev][i] = gestureNO_BUTTON;
+		}
+	}
+	for (i = 0; i < gestureNUM_BUTTONS; i++) {
+		ucInputButton[xButtonMap[i].device][xButtonMap[i].input] = (unsigned char) i;
+		usButtonInputs[xButtonMap[i].device] |= (1 << xButtonMap[i].input);
+		ucState[i] = gsIDLE;
+	}
+	ulArmed = 0;
+	ucKeyState = 0;
+}
+
+/*
+	uxGestureProcess()
+	- Description: Runs the debounced edges of one poll through the
+	button state machines, then any deadlines that have passed
+	- Parameters: pxEdges - debounced edges and their time
+								pxEvents - receives up to gestureMAX_EVENTS gestures
+	- Returns: number of gestures recognised
+*/
+unsigned portBASE_TYPE uxGestureProcess( const DebounceEdges *pxEdges, GestureEvent *pxEvents ) {
+	unsigned portBASE_TYPE uxCount = 0;
+	unsigned portBASE_TYPE dev, input;
+	unsigned short usPressed, usReleased;
+	unsigned long ulDue;
+	unsigned char button;
+	portTickType xNow = pxEdges->xTime;
+
+	for (dev = 0; dev < PCA9532_NUM_DEVICES; dev++) {
+		usReleased = pxEdges->usReleased[dev] & usButtonInputs[dev];
+		usPressed = pxEdges->usPressed[dev] & usButtonInputs[dev];
+		for (input = 0; (usReleased | usPressed) != 0; input++, usReleased >>= 1, usPressed >>= 1) {
+			button = ucInputButton[dev][input];
+			/* A release and press in one poll: the release came first */
+			if (usReleased & 1) {
+				prvStep(button, giRELEASE, xNow, pxEvents, &uxCount);
+			}
+			if (usPressed & 1) {
+				prvStep(button, giPRESS, xNow, pxEvents, &uxCount);
+				prvSequencePress(button, xNow, pxEvents, &uxCount);
+			}
+		}
+	}
+
+	if ((ulArmed != 0) && ((long) (xNow - xNextDeadline) >= 0)) {
+		ulDue = ulArmed;
+		ulArmed = 0;
+		/* Re-arm whatever is not due yet, expire the rest */
+		for (button = 0; ulDue != 0; button++, ulDue >>= 1) {
+			if ((ulDue & 1) == 0) {
+				continue;
+			}
+			if ((long) (xNow - xDeadline[button]) >= 0) {
+				prvStep(button, giDEADLINE, xDeadline[button], pxEvents, &uxCount);
+			} else {
+				if ((ulArmed == 0) || ((long) (xDeadline[button] - xNextDeadline) < 0)) {
+					xNextDeadline = xDeadline[button];
+				}
+				ulArmed |= (1UL << button);
+			}
+		}
+	}
+	return uxCount;
+}
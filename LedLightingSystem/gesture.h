@@ -0,0 +1,31 @@
+#ifndef GESTURE_H
+#define GESTURE_H
+
+#include "FreeRTOS.h"
+#include "debounce.h"
+#include "keycodes.h"
+
+/* Gesture timing (ms) */
+#define gestureHOLD_MS			1000	/* press this long for a hold */
+#define gestureDOUBLE_MS		500		/* second press within this for a double */
+
+/* Most gestures reported by one call of uxGestureProcess() */
+#define gestureMAX_EVENTS		8
+
+/* Gesture types */
+#define gestureNONE				0
+#define gesturePRESS			1	/* single press, released, no second press */
+#define gestureDOUBLE			2	/* second press soon after the first */
+#define gestureHOLD				3	/* held down for gestureHOLD_MS */
+#define gestureSEQUENCE			4	/* key code completed (keyCODE_...) */
+
+typedef struct GestureEvent {
+	unsigned char ucType;
+	unsigned char ucButton;		/* button, or key code for gestureSEQUENCE */
+	portTickType xTime;			/* tick the gesture was recognised */
+} GestureEvent;
+
+void vGestureInit( void );
+unsigned portBASE_TYPE uxGestureProcess( const DebounceEdges *pxEdges, GestureEvent *pxEvents );
+
+#endif
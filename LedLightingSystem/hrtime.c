@@ -0,0 +1,59 @@
+/*
+	High resolution timestamps built from the FreeRTOS tick count
+	and the TIMER0 counter that generates the tick. No extra timer
+	is used. Values wrap after 2^32 peripheral clock cycles (~6 min),
+	so only differences between two timestamps are meaningful.
+
+	Wesley Fung (fungw@tcd.ie)
+*/
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "lpc24xx.h"
+#include "hrtime.h"
+
+/* TIMER0 MR0 interrupt flag, set while the tick interrupt is pending */
+#define hrtimeTICK_PENDING		0x01
+
+/*
+	prvCombine()
+	- Description: Combines a tick count with the TIMER0 counter.
+	If the tick match has fired but not yet been serviced the counter
+	has already restarted from zero, so the pending tick is counted.
+	Interrupts must be disabled by the caller.
+	- Parameters: xTicks - current tick count
+*/
+static unsigned long prvCombine( portTickType xTicks ) {
+	unsigned long ulCount;
+
+	ulCount = T0TC;
+	if (T0IR & hrtimeTICK_PENDING) {
+		ulCount = T0TC;
+		xTicks++;
+	}
+	/* TIMER0 resets on match, so one tick is MR0 + 1 counts */
+	return (unsigned long) xTicks * (T0MR0 + 1) + ulCount;
+}
+
+/*
+	ulHRTimeGet()
+	- Description: Current timestamp; call from a task
+	- Parameters: N/A
+*/
+unsigned long ulHRTimeGet( void ) {
+	unsigned long ulNow;
+
+	portENTER_CRITICAL();
+	ulNow = prvCombine(xTaskGetTickCount());
+	portEXIT_CRITICAL();
+	return ulNow;
+}
+
+/*
+	ulHRTimeGetFromISR()
+	- Description: Current timestamp; call from an ISR
+	- Parameters: N/A
+*/
+unsigned long ulHRTimeGetFromISR( void ) {
+	return prvCombine(xTaskGetTickCountFromISR());
+}
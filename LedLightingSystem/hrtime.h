@@ -0,0 +1,12 @@
+#ifndef HRTIME_H
+#define HRTIME_H
+
+#include "FreeRTOS.h"
+
+/* High resolution timestamps are in peripheral clock cycles */
+#define hrtimeCOUNTS_PER_US		( configPERIPHERAL_CLOCK_HZ / 1000000UL )
+
+unsigned long ulHRTimeGet( void );
+unsigned long ulHRTimeGetFromISR( void );
+
+#endif
@@ -0,0 +1,534 @@
+/*
+	Interrupt driven I2C0 master driver. A transaction is described
+	by an I2CTransfer and the bus state machine is run from the I2C0
+	interrupt, so the calling task blocks instead of spinning on SI.
+
+	All transactions are run by one bus manager task, which takes
+	them from a request queue. Urgent requests (button reads) go to
+	the front of the queue and so overtake queued LED writes. The
+	requesting task is told of completion with a task notification.
+
+	Every bus phase has a deadline. A transfer that stops making
+	progress, or a STOP that never completes, is abandoned and the
+	bus is recovered by clocking SCL by hand until the slave releases
+	SDA. The caller always gets a result code back.
+
+	Wesley Fung (fungw@tcd.ie)
+*/
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "lpc24xx.h"
+#include <stdio.h>
+#include "i2c.h"
+#include "hrtime.h"
+
+#define I2C_AA      0x00000004
+#define I2C_SI      0x00000008
+#define I2C_STO     0x00000010
+#define I2C_STA     0x00000020
+#define I2C_I2EN    0x00000040
+
+/* I20STAT master mode status codes */
+#define i2cSTART_SENT				0x08
+#define i2cREPEATED_START_SENT		0x10
+#define i2cSLA_W_ACK				0x18
+#define i2cSLA_W_NACK				0x20
+#define i2cDATA_W_ACK				0x28
+#define i2cDATA_W_NACK				0x30
+#define i2cARBITRATION_LOST			0x38
+#define i2cBUS_ERROR				0x00
+#define i2cSLA_R_ACK				0x40
+#define i2cSLA_R_NACK				0x48
+#define i2cDATA_R_ACK				0x50
+#define i2cDATA_R_NACK				0x58
+
+/* Minimum SCL low/high times in ns (I2C specification) */
+#define i2cSTANDARD_MODE_HZ			100000UL
+#define i2cFAST_MODE_HZ				400000UL
+#define i2cSTANDARD_LOW_NS			4700UL
+#define i2cSTANDARD_HIGH_NS			4000UL
+#define i2cFAST_LOW_NS				1300UL
+#define i2cFAST_HIGH_NS				600UL
+
+/* I20SCLL/I20SCLH must each be at least 4 */
+#define i2cMIN_SCL_COUNT			4UL
+#define i2cMAX_SCL_COUNT			0xFFFFUL
+
+/* Deadlines: ticks without ISR progress before a transfer is
+   abandoned, and the wait for a requested STOP to go out */
+#define i2cPHASE_TIMEOUT			( ( portTickType ) 2 )
+#define i2cSTOP_TIMEOUT_US			100UL
+
+/* SDA (P0.27) and SCL (P0.28) as GPIO, for bus recovery */
+#define i2cSDA_PIN					( ( unsigned long ) ( 1 << 27 ) )
+#define i2cSCL_PIN					( ( unsigned long ) ( 1 << 28 ) )
+#define i2cPINSEL1_MASK				0x03C00000
+#define i2cPINSEL1_I2C				0x01400000
+#define i2cRECOVERY_CLOCKS			9
+#define i2cRECOVERY_HALF_BIT_US		5UL
+
+/* Bus manager task */
+#define i2cSTACK_SIZE				( ( unsigned portBASE_TYPE ) 128 )
+#define i2cQUEUE_LENGTH				( ( unsigned portBASE_TYPE ) 8 )
+
+/* Constants to setup the VIC for I2C0 */
+#define i2cVIC_CHANNEL_BIT			( ( unsigned long ) ( 1 << 9 ) )
+#define i2cVIC_PRIORITY				( ( unsigned long ) 9 )
+
+/* Interrupt handlers */
+extern void vI2C_ISREntry( void );
+void vI2C_ISRHandler( void );
+
+/* The bus manager task and its request queue of I2CTransfer pointers */
+static void vI2CBusTask( void *pvParameters );
+static xTaskHandle xBusTask;
+static xQueueHandle xRequestQ;
+
+/* Transaction currently owned by the ISR */
+static I2CTransfer * volatile pxCurrent;
+static volatile unsigned int uxTxIndex;
+static volatile unsigned int uxRxIndex;
+static volatile portBASE_TYPE xResult;
+/* Incremented by the ISR on every SI; used to detect a stalled phase */
+static volatile unsigned long ulSteps;
+
+/* Bus health */
+static unsigned long ulErrors[i2cNUM_RESULTS];
+static unsigned long ulRecoveries;
+static const char * const pcResultNames[i2cNUM_RESULTS] = {
+	"ok", "addr nack", "data nack", "arb lost", "bus error", "timeout"
+};
+
+/* Bus clock actually achieved by vI2CSetClock() */
+static unsigned long ulBusHz;
+
+/* Per-transaction timing, in peripheral clock cycles */
+static volatile unsigned long ulStartTime;
+static volatile unsigned long ulEndTime;
+static unsigned long ulTransfers;
+static unsigned long ulTimeLast;
+static unsigned long ulTimeMin;
+static unsigned long ulTimeMax;
+static unsigned long ulTimeTotal;
+
+/*
+	prvCountsFor()
+	- Description: Peripheral clock cycles needed to cover a time,
+	rounded up
+	- Parameters: ulNanoseconds - time to cover
+*/
+static unsigned long prvCountsFor( unsigned long ulNanoseconds ) {
+	return ((configPERIPHERAL_CLOCK_HZ / 1000) * ulNanoseconds + 999999) / 1000000;
+}
+
+/*
+	vStartI2C()
+	- Description: Powers up I2C0 on P0.27 (SDA) and P0.28 (SCL),
+	sets the bus clock, installs the I2C0 interrupt handler and
+	spawns the bus manager task.
+	- Parameters: uxPriority - Priority of the bus manager task
+*/
+void vStartI2C( unsigned portBASE_TYPE uxPriority ) {
+	xRequestQ = xQueueCreate(i2cQUEUE_LENGTH, sizeof(I2CTransfer *));
+
+	/* Enable and configure I2C0 */
+	PCONP    |=  (1 << 7);                /* Enable power for I2C0              */
+
+	/* Initialize pins for SDA (P0.27) and SCL (P0.28) functions                */
+	PINSEL1  &= ~i2cPINSEL1_MASK;
+	PINSEL1  |=  i2cPINSEL1_I2C;
+
+	/* Clear I2C state machine                                                  */
+	I20CONCLR =  I2C_AA | I2C_SI | I2C_STA | I2C_I2EN;
+
+	/* Setup I2C clock speed                                                    */
+	vI2CSetClock(i2cDEFAULT_BUS_HZ);
+	ulTimeMin = 0xFFFFFFFF;
+
+	/* Setup VIC for I2C0 interrupts */
+	VICIntSelect &= ~i2cVIC_CHANNEL_BIT;	/* Configure vector 9 (I2C0) for IRQ */
+	VICVectPriority9 = i2cVIC_PRIORITY;
+	VICVectAddr9 = (unsigned long)vI2C_ISREntry;
+	VICIntEnable = i2cVIC_CHANNEL_BIT;
+
+	I20CONSET =  I2C_I2EN;
+
+	/* Spawn the bus manager task. */
+	xTaskCreate( vI2CBusTask, "I2C", i2cSTACK_SIZE, NULL, uxPriority, &xBusTask );
+}
+
+/*
+	vI2CSetClock()
+	- Description: Programs I20SCLL/I20SCLH for the requested bus
+	frequency (up to 400 kHz Fast-mode). The minimum SCL low and
+	high times of the selected mode are honoured first and any
+	remaining cycles are split evenly, so the real frequency may
+	come out slightly below the request but never above it.
+	Call before the scheduler starts or while the bus is idle.
+	- Parameters: ulWantedHz - requested SCL frequency
+*/
+void vI2CSetClock( unsigned long ulWantedHz ) {
+	unsigned long ulTotal;
+	unsigned long ulLow;
+	unsigned long ulHigh;
+	unsigned long ulSpare;
+
+	if (ulWantedHz > i2cFAST_MODE_HZ) {
+		ulWantedHz = i2cFAST_MODE_HZ;
+	}
+
+	/* Minimum low/high periods for the mode in use */
+	if (ulWantedHz > i2cSTANDARD_MODE_HZ) {
+		ulLow = prvCountsFor(i2cFAST_LOW_NS);
+		ulHigh = prvCountsFor(i2cFAST_HIGH_NS);
+	} else {
+		ulLow = prvCountsFor(i2cSTANDARD_LOW_NS);
+		ulHigh = prvCountsFor(i2cSTANDARD_HIGH_NS);
+	}
+	if (ulLow < i2cMIN_SCL_COUNT) {
+		ulLow = i2cMIN_SCL_COUNT;
+	}
+	if (ulHigh < i2cMIN_SCL_COUNT) {
+		ulHigh = i2cMIN_SCL_COUNT;
+	}
+
+	/* Round the period up so the bus never runs faster than asked */
+	ulTotal = (configPERIPHERAL_CLOCK_HZ + ulWantedHz - 1) / ulWantedHz;
+	if (ulTotal > ulLow + ulHigh) {
+		ulSpare = ulTotal - ulLow - ulHigh;
+		ulHigh += ulSpare / 2;
+		ulLow += ulSpare - ulSpare / 2;
+	}
+	if (ulLow > i2cMAX_SCL_COUNT) {
+		ulLow = i2cMAX_SCL_COUNT;
+	}
+	if (ulHigh > i2cMAX_SCL_COUNT) {
+		ulHigh = i2cMAX_SCL_COUNT;
+	}
+
+	I20SCLL = ulLow;
+	I20SCLH = ulHigh;
+	ulBusHz = configPERIPHERAL_CLOCK_HZ / (ulLow + ulHigh);
+}
+
+/*
+	prvDelayUs()
+	- Description: Busy-waits for a short time. Only used while
+	recovering the bus, when the interface is disabled anyway.
+	- Parameters: ulMicroseconds - time to wait
+*/
+static void prvDelayUs( unsigned long ulMicroseconds ) {
+	unsigned long ulStart = ulHRTimeGet();
+
+	while (ulHRTimeGet() - ulStart < ulMicroseconds * hrtimeCOUNTS_PER_US);
+}
+
+/*
+	prvWaitForStop()
+	- Description: Waits for the STOP requested by the ISR to go
+	out on the bus. STO only stays set if SCL is being held low.
+	- Parameters: N/A
+	- Returns: pdFAIL if STO did not clear in time
+*/
+static portBASE_TYPE prvWaitForStop( void ) {
+	unsigned long ulStart = ulHRTimeGet();
+
+	while (I20CONSET & I2C_STO) {
+		if (ulHRTimeGet() - ulStart > i2cSTOP_TIMEOUT_US * hrtimeCOUNTS_PER_US) {
+			return pdFAIL;
+		}
+	}
+	return pdPASS;
+}
+
+/*
+	prvRecoverBus()
+	- Description: Abandons the transfer in progress and frees a
+	stuck bus. SDA and SCL are switched to GPIO, SCL is clocked
+	until the slave releases SDA (at most one byte plus ACK), a
+	STOP is generated by hand and the interface is re-enabled.
+	- Parameters: N/A
+*/
+static void prvRecoverBus( void ) {
+	unsigned int i;
+
+	ulRecoveries++;
+
+	/* Abandon the transfer and disable the interface */
+	pxCurrent = NULL;
+	I20CONCLR = I2C_AA | I2C_SI | I2C_STA | I2C_I2EN;
+
+	/* Take over the pins as open-drain GPIO, both released */
+	IOSET0 = i2cSDA_PIN | i2cSCL_PIN;
+	IODIR0 |= i2cSDA_PIN | i2cSCL_PIN;
+	PINSEL1 &= ~i2cPINSEL1_MASK;
+
+	/* Clock SCL until the slave lets go of SDA */
+	for (i = 0; (i < i2cRECOVERY_CLOCKS) && ((IOPIN0 & i2cSDA_PIN) == 0); i++) {
+		IOCLR0 = i2cSCL_PIN;
+		prvDelayUs(i2cRECOVERY_HALF_BIT_US);
+		IOSET0 = i2cSCL_PIN;
+		prvDelayUs(i2cRECOVERY_HALF_BIT_US);
+	}
+
+	/* STOP condition: SDA rises while SCL is high */
+	IOCLR0 = i2cSCL_PIN;
+	prvDelayUs(i2cRECOVERY_HALF_BIT_US);
+	IOCLR0 = i2cSDA_PIN;
+	prvDelayUs(i2cRECOVERY_HALF_BIT_US);
+	IOSET0 = i2cSCL_PIN;
+	prvDelayUs(i2cRECOVERY_HALF_BIT_US);
+	IOSET0 = i2cSDA_PIN;
+	prvDelayUs(i2cRECOVERY_HALF_BIT_US);
+
+	/* Hand the pins back to I2C0 and restart it */
+	IODIR0 &= ~(i2cSDA_PIN | i2cSCL_PIN);
+	PINSEL1 |= i2cPINSEL1_I2C;
+	I20CONCLR = I2C_AA | I2C_SI | I2C_STA | I2C_STO;
+	I20CONSET = I2C_I2EN;
+
+	/* Discard a completion that raced with the timeout */
+	ulTaskNotifyTake(pdTRUE, 0);
+}
+
+/*
+	xI2CTransfer()
+	- Description: Queues one transaction for the bus manager task
+	and blocks the calling task until it has completed.
+	Must be called from a task.
+	- Parameters: pxTransfer - transaction to run
+								uxPriority - i2cPRIORITY_URGENT to jump the queue,
+								i2cPRIORITY_NORMAL otherwise
+	- Returns: i2cOK, or the i2cERR_ code of the failure
+*/
+portBASE_TYPE xI2CTransfer( I2CTransfer *pxTransfer, unsigned portBASE_TYPE uxPriority ) {
+	uint32_t ulNotified;
+
+	pxTransfer->xRequester = xTaskGetCurrentTaskHandle();
+	pxTransfer->xResult = i2cERR_TIMEOUT;
+
+	if (uxPriority == i2cPRIORITY_URGENT) {
+		xQueueSendToFront(xRequestQ, &pxTransfer, portMAX_DELAY);
+	} else {
+		xQueueSendToBack(xRequestQ, &pxTransfer, portMAX_DELAY);
+	}
+
+	/* Wait for the bus manager to signal this transfer is done */
+	do {
+		xTaskNotifyWait(0, i2cNOTIFY_DONE, &ulNotified, portMAX_DELAY);
+	} while ((ulNotified & i2cNOTIFY_DONE) == 0);
+
+	return pxTransfer->xResult;
+}
+
+/*
+	xI2CTransferFromISR()
+	- Description: Queues one urgent transaction from an interrupt
+	without waiting for it. Nobody is notified of completion, so
+	the descriptor (and its data) must be static and must not be
+	changed while xPending is set; it is cleared once the transfer
+	has run and xResult holds its result.
+	- Parameters: pxTransfer - transaction to run
+								pxHigherPriorityTaskWoken - from the ISR
+	- Returns: pdFAIL if the transfer is still pending or the request
+	queue is full
+*/
+portBASE_TYPE xI2CTransferFromISR( I2CTransfer *pxTransfer, portBASE_TYPE *pxHigherPriorityTaskWoken ) {
+	if (pxTransfer->xPending != pdFALSE) {
+		return pdFAIL;
+	}
+	pxTransfer->xRequester = NULL;
+	pxTransfer->xResult = i2cERR_TIMEOUT;
+	pxTransfer->xPending = pdTRUE;
+
+	if (xQueueSendToFrontFromISR(xRequestQ, &pxTransfer, pxHigherPriorityTaskWoken) != pdTRUE) {
+		pxTransfer->xPending = pdFALSE;
+		return pdFAIL;
+	}
+	return pdPASS;
+}
+
+/*
+	portTASK_FUNCTION()
+	- Description: Bus manager task. Runs queued transactions one
+	at a time and notifies each requester when its one is done.
+	- Parameters: vI2CBusTask - Task
+								pvParameters - Not used
+*/
+static portTASK_FUNCTION( vI2CBusTask, pvParameters ) {
+	I2CTransfer *pxTransfer;
+	xTaskHandle xRequester;
+	unsigned long ulLastSteps;
+
+	/* Just to stop compiler warnings. */
+	( void ) pvParameters;
+
+	for( ;; )
+	{
+		xQueueReceive(xRequestQ, &pxTransfer, portMAX_DELAY);
+
+		pxCurrent = pxTransfer;
+		uxTxIndex = 0;
+		uxRxIndex = 0;
+		xResult = i2cERR_TIMEOUT;
+
+		/* Request send START; the ISR takes it from here */
+		ulStartTime = ulHRTimeGet();
+		I20CONCLR = I2C_AA | I2C_SI | I2C_STA;
+		I20CONSET = I2C_STA;
+
+		/* Wait for completion; give up once a phase stalls */
+		ulLastSteps = ulSteps;
+		while (ulTaskNotifyTake(pdTRUE, i2cPHASE_TIMEOUT) == 0) {
+			if (ulSteps == ulLastSteps) {
+				ulEndTime = ulHRTimeGet();
+				break;
+			}
+			ulLastSteps = ulSteps;
+		}
+
+		if ((xResult == i2cERR_TIMEOUT) || (prvWaitForStop() == pdFAIL)) {
+			xResult = i2cERR_TIMEOUT;
+			prvRecoverBus();
+		}
+		ulErrors[xResult]++;
+
+		ulTimeLast = ulEndTime - ulStartTime;
+		ulTimeTotal += ulTimeLast;
+		if (ulTimeLast < ulTimeMin) {
+			ulTimeMin = ulTimeLast;
+		}
+		if (ulTimeLast > ulTimeMax) {
+			ulTimeMax = ulTimeLast;
+		}
+		ulTransfers++;
+
+		/* The descriptor may live on the requester's stack, so it
+		must not be touched once the requester has been woken */
+		xRequester = pxTransfer->xRequester;
+		pxTransfer->xResult = xResult;
+		if (xRequester != NULL) {
+			xTaskNotify(xRequester, i2cNOTIFY_DONE, eSetBits);
+		} else {
+			pxTransfer->xPending = pdFALSE;
+		}
+	}
+}
+
+/*
+	vI2CPrintStats()
+	- Description: Prints the bus clock and transaction timing
+	(START request to STOP request) on the console
+	- Parameters: N/A
+*/
+void vI2CPrintStats( void ) {
+	unsigned portBASE_TYPE i;
+	unsigned long ulAverage = (ulTransfers > 0) ? ulTimeTotal / ulTransfers : 0;
+
+	printf("I2C0: %lu Hz (SCLL %lu, SCLH %lu), %lu transfers\r\n", ulBusHz, (unsigned long) I20SCLL, (unsigned long) I20SCLH, ulTransfers);
+	if (ulTransfers > 0) {
+		printf("I2C0 us: last %lu, min %lu, avg %lu, max %lu\r\n",
+			ulTimeLast / hrtimeCOUNTS_PER_US, ulTimeMin / hrtimeCOUNTS_PER_US,
+			ulAverage / hrtimeCOUNTS_PER_US, ulTimeMax / hrtimeCOUNTS_PER_US);
+	}
+	for (i = i2cERR_ADDRESS_NACK; i < i2cNUM_RESULTS; i++) {
+		printf("I2C0 %s: %lu\r\n", pcResultNames[i], ulErrors[i]);
+	}
+	printf("I2C0 recoveries: %lu\r\n", ulRecoveries);
+}
+
+/*
+	prvFinish()
+	- Description: Requests STOP and wakes the bus manager task.
+	Called from the ISR only.
+	- Parameters: xStatus - i2cOK or an i2cERR_ code
+								pxHigherPriorityTaskWoken - from the ISR
+*/
+static void prvFinish( portBASE_TYPE xStatus, portBASE_TYPE *pxHigherPriorityTaskWoken ) {
+	I20CONSET = I2C_STO;
+	I20CONCLR = I2C_AA;
+	ulEndTime = ulHRTimeGetFromISR();
+	xResult = xStatus;
+	pxCurrent = NULL;
+	vTaskNotifyGiveFromISR(xBusTask, pxHigherPriorityTaskWoken);
+}
+
+/*
+	vI2C_ISRHandler()
+	- Description: I2C0 master state machine, one step per SI
+	- Parameters: N/A
+*/
+void vI2C_ISRHandler( void ) {
+	portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+	I2CTransfer *pxTransfer = pxCurrent;
+
+	ulSteps++;
+	if (pxTransfer == NULL) {
+		/* Spurious; nothing in flight */
+		I20CONSET = I2C_STO;
+	} else {
+		switch (I20STAT) {
+			case i2cSTART_SENT:
+				/* Address with R/W bit; skip the write phase if empty */
+				I20DAT = (pxTransfer->txLength > 0) ? pxTransfer->address : (pxTransfer->address | 1);
+				I20CONCLR = I2C_STA;
+				break;
+			case i2cREPEATED_START_SENT:
+				I20DAT = pxTransfer->address | 1;
+				I20CONCLR = I2C_STA;
+				break;
+			case i2cSLA_W_ACK:
+			case i2cDATA_W_ACK:
+				if (uxTxIndex < pxTransfer->txLength) {
+					I20DAT = pxTransfer->txData[uxTxIndex++];
+				} else if (pxTransfer->rxLength > 0) {
+					/* Request send repeated START */
+					I20CONSET = I2C_STA;
+				} else {
+					prvFinish(i2cOK, &xHigherPriorityTaskWoken);
+				}
+				break;
+			case i2cSLA_R_ACK:
+				/* ACK every byte except the last */
+				if (pxTransfer->rxLength > 1) {
+					I20CONSET = I2C_AA;
+				} else {
+					I20CONCLR = I2C_AA;
+				}
+				break;
+			case i2cDATA_R_ACK:
+				pxTransfer->rxData[uxRxIndex++] = I20DAT;
+				if (uxRxIndex + 1 >= pxTransfer->rxLength) {
+					I20CONCLR = I2C_AA;
+				}
+				break;
+			case i2cDATA_R_NACK:
+				pxTransfer->rxData[uxRxIndex++] = I20DAT;
+				prvFinish(i2cOK, &xHigherPriorityTaskWoken);
+				break;
+			case i2cSLA_W_NACK:
+			case i2cSLA_R_NACK:
+				prvFinish(i2cERR_ADDRESS_NACK, &xHigherPriorityTaskWoken);
+				break;
+			case i2cDATA_W_NACK:
+				prvFinish(i2cERR_DATA_NACK, &xHigherPriorityTaskWoken);
+				break;
+			case i2cARBITRATION_LOST:
+				prvFinish(i2cERR_ARBITRATION, &xHigherPriorityTaskWoken);
+				break;
+			case i2cBUS_ERROR:
+			default:
+				prvFinish(i2cERR_BUS, &xHigherPriorityTaskWoken);
+				break;
+		}
+	}
+
+	I20CONCLR = I2C_SI;
+	VICVectAddr = 0;			/* Clear VIC interrupt */
+
+	/* Exit the ISR.  If the bus manager task was woken then a context
+	switch will occur. */
+	portEXIT_SWITCHING_ISR( xHigherPriorityTaskWoken );
+}
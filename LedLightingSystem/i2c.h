@@ -0,0 +1,51 @@
+#ifndef I2C_H
+#define I2C_H
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* SCL frequency programmed by vStartI2C(); the PCA9532 supports Fast-mode */
+#define i2cDEFAULT_BUS_HZ		( ( unsigned long ) 400000 )
+
+/* Request priorities for xI2CTransfer() */
+#define i2cPRIORITY_NORMAL		( ( unsigned portBASE_TYPE ) 0 )
+#define i2cPRIORITY_URGENT		( ( unsigned portBASE_TYPE ) 1 )
+
+/* Transfer results */
+#define i2cOK					0
+#define i2cERR_ADDRESS_NACK		1
+#define i2cERR_DATA_NACK		2
+#define i2cERR_ARBITRATION		3
+#define i2cERR_BUS				4
+#define i2cERR_TIMEOUT			5
+#define i2cNUM_RESULTS			6
+
+/* Task notification bit used to signal completion to a requester */
+#define i2cNOTIFY_DONE			( ( unsigned long ) 0x80000000 )
+
+/*
+	Describes one I2C0 bus transaction. The write phase (if any) is sent
+	first, then a repeated START switches to the read phase (if any).
+	address is the 8-bit write address of the slave (e.g. 0xC0).
+	xRequester and xResult are filled in by the driver; xRequester
+	is NULL for a transfer queued from an interrupt, and xPending is
+	set from then until that transfer has run.
+*/
+typedef struct I2CTransfer {
+	unsigned char address;
+	const unsigned char *txData;
+	unsigned int txLength;
+	unsigned char *rxData;
+	unsigned int rxLength;
+	xTaskHandle xRequester;
+	portBASE_TYPE xResult;
+	volatile portBASE_TYPE xPending;
+} I2CTransfer;
+
+void vStartI2C( unsigned portBASE_TYPE uxPriority );
+void vI2CSetClock( unsigned long ulWantedHz );
+portBASE_TYPE xI2CTransfer( I2CTransfer *pxTransfer, unsigned portBASE_TYPE uxPriority );
+portBASE_TYPE xI2CTransferFromISR( I2CTransfer *pxTransfer, portBASE_TYPE *pxHigherPriorityTaskWoken );
+void vI2CPrintStats( void );
+
+#endif
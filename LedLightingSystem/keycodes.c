@@ -0,0 +1,32 @@
+/*
+	Generated by tools/keycodes.py from tools/keycodes.txt.
+	Do not edit; change keycodes.txt and regenerate.
+*/
+
+#include "keycodes.h"
+
+/* State after each key press, from each state */
+const unsigned char ucKeyNext[keyNUM_STATES][keyNUM_KEYS] = {
+	{   0,   5,   1,   0 },
+	{   0,   2,   1,   0 },
+	{   3,   5,   1,   0 },
+	{   4,   5,   1,   7 },
+	{   0,   5,   1,   0 },
+	{   6,   5,   1,   0 },
+	{   0,   5,   1,   7 },
+	{   8,   5,   1,   0 },
+	{   0,   5,   1,   0 }
+};
+
+/* Codes completed on reaching each state */
+const unsigned long ulKeyMatch[keyNUM_STATES] = {
+	0x00000000UL,
+	0x00000000UL,
+	0x00000000UL,
+	0x00000000UL,
+	0x00000001UL,
+	0x00000000UL,
+	0x00000000UL,
+	0x00000000UL,
+	0x00000002UL
+};
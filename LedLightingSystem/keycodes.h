@@ -0,0 +1,20 @@
+/*
+	Generated by tools/keycodes.py from tools/keycodes.txt.
+	Do not edit; change keycodes.txt and regenerate.
+*/
+
+#ifndef KEYCODES_H
+#define KEYCODES_H
+
+/* Key codes; bit n of ulKeyMatch[] is code n */
+#define keyCODE_FIRE_ON		0	/* 2 1 0 0 */
+#define keyCODE_FIRE_OFF		1	/* 1 0 3 0 */
+#define keyNUM_CODES		2
+
+#define keyNUM_KEYS			4
+#define keyNUM_STATES		9
+
+extern const unsigned char ucKeyNext[keyNUM_STATES][keyNUM_KEYS];
+extern const unsigned long ulKeyMatch[keyNUM_STATES];
+
+#endif
@@ -9,19 +9,26 @@
 
 #include "FreeRTOS.h"
 #include "task.h"
-#include "semphr.h"
+#include "queue.h"
 #include "lcd.h"
 #include "lcd_hw.h"
 #include "lcd_grph.h"
 #include "timers.h"
 #include "ui.h"
 #include "commands.h"
+#include "coalesce.h"
+#include "bus.h"
+#include "evlog.h"
 #include <stdio.h>
 #include <string.h>
 
 /* Maximum task stack size */
 #define lcdSTACK_SIZE			( ( unsigned portBASE_TYPE ) 256 )
 
+/* Notification bits of the LCD task */
+#define lcdNOTIFY_TOUCH			( ( unsigned long ) 0x01 )
+#define lcdNOTIFY_EVENT			( ( unsigned long ) 0x02 )
+
 /* Interrupt handlers */
 extern void vLCD_ISREntry( void );
 void vLCD_ISRHandler( void );
@@ -29,8 +36,8 @@ void vLCD_ISRHandler( void );
 /* The LCD task. */
 static void vLcdTask( void *pvParameters );
 
-xSemaphoreHandle xLcdSemphr;
-xQueueHandle xFromSensorsQ;
+static xTaskHandle xLcdTask;
+static unsigned portBASE_TYPE uxLcdSubscriber;
 TimerHandle_t xTimerSavePreset;
 TimerHandle_t xTimerSavedNotion;
 xQueueHandle xCmdLCDQ;
@@ -44,10 +51,8 @@ int FIRE;
 	- Parameters: xTimerSavePreset - Preset saving timer
 */
 void PresetSavedTimeout(TimerHandle_t xTimerSavePreset) {
-	xTimerReset(xTimerSavePreset, 0);
-	xTimerStop(xTimerSavePreset, 0);
 	drawStatusBar(1);
-	xQueueSendToBack(xCmdLCDQ, &GLOBAL_COMMAND, 0);
+	xCoalescePost(GLOBAL_COMMAND);
 	xTimerStart(xTimerSavedNotion, 0);
 }
 
@@ -59,31 +64,76 @@ void PresetSavedTimeout(TimerHandle_t xTimerSavePreset) {
 */
 void RemoveIndicator(TimerHandle_t xTimerSavedNotion) {
 	drawStatusBar(0);
-	xTimerReset(xTimerSavedNotion, 0);
-	xTimerStop(xTimerSavedNotion, 0);
 }
 
 /*
 	vStartLcd()
 	- Description: LCD task start
 	- Parameters: uxPriority - Priority
-								xQueue - LCD queue
-								xSensorsQueue - Sensors queue
-								xLSSemphr - LCD semaphore
+								xQueue - Sensors queue
 */
-void vStartLcd( unsigned portBASE_TYPE uxPriority, xQueueHandle xFromUIQ, xQueueHandle xToLCDQueue, xSemaphoreHandle xLSemphr ){
+void vStartLcd( unsigned portBASE_TYPE uxPriority, xQueueHandle xFromUIQ ){
 	static xQueueHandle xCmdQ;
 	xCmdQ = xFromUIQ;
-	xLcdSemphr = xLSemphr;
-	xFromSensorsQ = xToLCDQueue;
 	
 	/* Spawn the console task. */
-	xTaskCreate( vLcdTask, "Lcd", lcdSTACK_SIZE, &xCmdQ, uxPriority, ( xTaskHandle * ) NULL );
+	xTaskCreate( vLcdTask, "Lcd", lcdSTACK_SIZE, &xCmdQ, uxPriority, &xLcdTask );
+
+	/* Zone and alarm changes come from the event bus */
+	xBusSubscribe("lcd", busTOPIC(busZONE_STATE) | busTOPIC(busALARM), xLcdTask, lcdNOTIFY_EVENT, &uxLcdSubscriber);
 	
 	xTimerSavePreset = xTimerCreate("TimerSavePreset", 2000, pdFALSE, (void *) 0, PresetSavedTimeout);
 	xTimerSavedNotion = xTimerCreate("TimerSaved", 3000, pdFALSE, (void *) 0, RemoveIndicator);
 }
 
+/*
+	showEvents()
+	- Description: Shows every zone and alarm event received from
+	the event bus on the UI, then redraws it once
+	- Parameters: N/A
+*/
+static void showEvents( void ) {
+	Command event;
+	int shown = 0;
+
+	while (xBusReceive(uxLcdSubscriber, &event) == pdPASS) {
+		switch(cmdACTION(event)) {
+			case cmdLCD_SHUTDOWN:
+				forceShutdown();
+				break;
+			case cmdLCD_REFLECT:
+				reflectState(cmdSTATE(event));
+				break;
+			case cmdLCD_FIRE_PHASE1:
+				drawButtons(1);
+				FIRE = 1;
+				break;
+			case cmdLCD_FIRE_PHASE2:
+				drawButtons(2);
+				FIRE = 1;
+				break;
+			case cmdLCD_FIRE_OFF:
+				FIRE = 0;
+				break;
+			default:
+				break;
+		}
+		shown = 1;
+	}
+	if (shown == 0) {
+		return;
+	}
+
+	/* During a fire alarm the phases draw the buttons themselves */
+	if (FIRE == 0) {
+		drawStatusBar(0);
+		drawButtons(0);
+	} else {
+		drawStatusBar(2);
+	}
+	drawSlider();
+}
+
 /*
 	portTASK_FUNCTION()
 	- Description: Main for LCD file
@@ -95,10 +145,9 @@ static portTASK_FUNCTION( vLcdTask, pvParameters ) {
 	unsigned int xPos;
 	unsigned int yPos;
 	portTickType xLastWakeTime;
-	int clapState;
+	uint32_t ulNotified;
 	
 	Command cmd;
-	Command receiveCMD;
 	
 	xCmdLCDQ = * ( ( xQueueHandle * ) pvParameters );
 	FIRE = 0;
@@ -113,11 +162,11 @@ static portTASK_FUNCTION( vLcdTask, pvParameters ) {
 	lcd_init();
 	initial(xCmdLCDQ);
 
-	/* Infinite loop blocks waiting for a touch screen interrupt event from
-	the queue.*/
+	/* Infinite loop blocks waiting for a touch screen interrupt or an
+	event from the bus.*/
 	for( ;; )
 	{
-		Command presetCommand;
+		Command presetCommand = cmdPACK(cmdNONE, 0, 0, 0);
 		
 		/* Clear TS interrupts (EINT3) */
 		/* Reset and (re-)enable TS interrupts on EINT3 */
@@ -126,44 +175,14 @@ static portTASK_FUNCTION( vLcdTask, pvParameters ) {
 		/* Enable TS interrupt vector (VIC) (vector 17) */
 		VICIntEnable = 1 << 17;			/* Enable interrupts on vector 17 */
 		
-		/* Block on a queue waiting for an event from the TS interrupt handler */
-		xSemaphoreTake(xLcdSemphr, portMAX_DELAY);
+		/* Block until the TS interrupt handler or the bus notifies us */
+		xTaskNotifyWait(0, 0xFFFFFFFF, &ulNotified, portMAX_DELAY);
 		
-		// Receive commands from sensors queue
-		xQueueReceive(xFromSensorsQ, &receiveCMD, 0);
-		/*
-			Button pressed # cases
-			3 - Forces shutdown
-			4 - Forces reflection of state
-			5 - Alternating FIRE1 state
-			6 - Alternating FIRE2 state
-			7 - Turn the fire off
-		*/
-		switch(receiveCMD.action) {
-			case 3:
-				forceShutdown();
-				break;
-			case 4:
-				reflectState(receiveCMD.state);
-				break;
-			case 5:
-				drawButtons(1);
-				FIRE = 1;
-				break;
-			case 6:
-				drawButtons(2);
-				FIRE = 1;
-				break;
-			case 7:
-				FIRE = 0;
-				break;
-			case 8:
-				clapState = getLEDState(receiveCMD.identifier);
-				cmd.value = clapState;
-				xQueueSendToBack(xCmdLCDQ, &cmd, portMAX_DELAY);
-				break;
-			default:
-				break;
+		if (ulNotified & lcdNOTIFY_EVENT) {
+			showEvents();
+		}
+		if ((ulNotified & lcdNOTIFY_TOUCH) == 0) {
+			continue;
 		}
 		
 		/* Disable TS interrupt vector (VIC) (vector 17) */
@@ -175,6 +194,7 @@ static portTASK_FUNCTION( vLcdTask, pvParameters ) {
 		/* Start polling the touchscreen pressure and position ( getTouch(...) ) */
 		/* Keep polling until pressure == 0 */
 		getTouch(&xPos, &yPos, &pressure);
+		vEvLogRecord(evlogTOUCH, ((unsigned long) xPos << 12) | (yPos & 0xFFF));
 		
 		/* 
 			- Draws different status bar depending on FIRE state
@@ -182,11 +202,11 @@ static portTASK_FUNCTION( vLcdTask, pvParameters ) {
 		*/
 		if (FIRE == 0) {
 			cmd = checkPressed(xPos, yPos);
-			if ((cmd.action >= 0) && (cmd.action < 10))
-				xQueueSendToBack(xCmdLCDQ, &cmd, 0);
+			if (cmdACTION(cmd) != cmdNONE)
+				xCoalescePost(cmd);
 			cmd = checkSliderButton(xPos, yPos);
-			if ((cmd.action >= 0) && (cmd.action < 10))
-				xQueueSendToBack(xCmdLCDQ, &cmd, 0);
+			if (cmdACTION(cmd) != cmdNONE)
+				xCoalescePost(cmd);
 			presetCommand = checkPresets(xPos, yPos);
 			drawStatusBar(0);
 		} else {
@@ -194,7 +214,7 @@ static portTASK_FUNCTION( vLcdTask, pvParameters ) {
 		}
 		
 		// Checking whether FIRE state, draw buttons accordingly
-		if ((receiveCMD.action != 5) && (receiveCMD.action != 6) && (FIRE == 0)) {
+		if (FIRE == 0) {
 			drawButtons(0);
 		}
 		drawSlider();
@@ -203,27 +223,27 @@ static portTASK_FUNCTION( vLcdTask, pvParameters ) {
 			/* Get current pressure */
 			getTouch(&xPos, &yPos, &pressure);
 			/* While pressure is pressed, checks whether the button is HELD for default (2s) */
-			if ((presetCommand.action == 2) && (xTimerIsTimerActive(xTimerSavePreset) == pdFALSE)) {
+			if ((cmdACTION(presetCommand) == cmdPRESET_SAVE) && (xTimerIsTimerActive(xTimerSavePreset) == pdFALSE)) {
 				GLOBAL_COMMAND = presetCommand;
 				xTimerStart(xTimerSavePreset, 0);
 			}
+			/* Keep up with the bus while the screen is held */
+			if ((xTaskNotifyWait(0, lcdNOTIFY_EVENT, &ulNotified, 0) == pdTRUE) && (ulNotified & lcdNOTIFY_EVENT)) {
+				showEvents();
+			}
 			/* Delay to give us a 25ms periodic TS pressure sample */
 			vTaskDelayUntil( &xLastWakeTime, 25 );
 			
 		}
-		xTimerReset(xTimerSavePreset, 0);
 		xTimerStop(xTimerSavePreset, 0);
 		/* +++ This point in the code can be interpreted as a screen button release event +++ */
 		presetReset();
 		
 		// Re-draws buttons - noticeable UX effect when preset buttons are not re-drawn
-		if ((receiveCMD.action != 5) && (receiveCMD.action != 6) && (FIRE == 0)) {
+		if (FIRE == 0) {
 			drawButtons(0);
 		}
 		
-		cmd.action = -1;
-		receiveCMD.action = -1;
-		receiveCMD.state = 0x00;
 		xPos = 0;
 		yPos = 0;
 	}
@@ -239,7 +259,7 @@ void vLCD_ISRHandler( void ) {
 
 	/* Process the touchscreen interrupt */
 	/* We would want to indicate to the task above that an event has occurred */
-	xSemaphoreGiveFromISR(xLcdSemphr, &xHigherPriorityTaskWoken);
+	xTaskNotifyFromISR(xLcdTask, lcdNOTIFY_TOUCH, eSetBits, &xHigherPriorityTaskWoken);
 
 	EXTINT = 8;					/* Reset EINT3 */
 	VICVectAddr = 0;			/* Clear VIC interrupt */
@@ -1,6 +1,6 @@
 #ifndef LCD_H
 #define LCD_H
 
-void vStartLcd( unsigned portBASE_TYPE uxPriority, xQueueHandle xQueue, xQueueHandle xLCDQueue, xSemaphoreHandle xLcdSemphr );
+void vStartLcd( unsigned portBASE_TYPE uxPriority, xQueueHandle xQueue );
 
 #endif
@@ -3,7 +3,6 @@
 
 /* Scheduler includes. */
 #include "FreeRTOS.h"
-#include "semphr.h"
 #include "task.h"
 #include "queue.h"
 #include "console.h"
@@ -12,11 +11,14 @@
 #include "lcd_grph.h"
 
 #include "sensors.h"
+#include "i2c.h"
+#include "wheel.h"
 #include "commands.h"
 
 extern void vLCD_ISREntry( void );
 
-#define EVQ_MAX_EVENTS 10
+/* Commands are one word each (see commands.h), so deep queues are cheap */
+#define EVQ_MAX_EVENTS 32
 
 /*
  * Configure the processor for use with the Keil demo board.  This is very
@@ -27,8 +29,6 @@ static void prvSetupHardware( void );
 
 int main (void) {
 	xQueueHandle xFromUIQ;
-	xQueueHandle xToLCDQueue;
-	xSemaphoreHandle xLcdSemphr;
 	
 	/* Setup the hardware for use with the Keil demo board. */
 	prvSetupHardware();
@@ -36,18 +36,25 @@ int main (void) {
 	/* Create a FreeRTOS Queue to send commands from the Producer task to
 	   the consumer task. */
 	xFromUIQ = xQueueCreate(EVQ_MAX_EVENTS, sizeof(Command));
-	xToLCDQueue = xQueueCreate(EVQ_MAX_EVENTS, sizeof(Command));
-	vSemaphoreCreateBinary(xLcdSemphr);
 	
   /* Start the console task */
 	vStartConsole(1, 19200);
 
-	/* Start the lcd task */
-	vStartLcd(2, xFromUIQ, xToLCDQueue, xLcdSemphr);
+	/* Start the I2C bus manager task; it owns every PCA9532 access */
+	vStartI2C(3);
+
+#if wheelBENCHMARK == 1
+	/* Start the timing wheel task (runs timers next to the kernel's).
+	Only the benchmark uses it, so it costs nothing otherwise. */
+	vStartWheel(3);
+#endif
+
+	/* Start the lcd task; it subscribes to the lighting event bus */
+	vStartLcd(2, xFromUIQ);
 	
 	/* Start the lcd task, passing it a pointer to the handle for the
 	 * button event queue */
-	vStartSensors(1, xFromUIQ, xToLCDQueue, xLcdSemphr);
+	vStartSensors(1, xFromUIQ);
 
 	/* Start the FreeRTOS Scheduler ... after this we're pre-emptive multitasking ...
 
@@ -0,0 +1,286 @@
+/*
+	Per-zone occupancy. Each zone in use has a vacancy deadline; when
+	it passes the zone is dimmed, and if nobody touches it during the
+	grace period it is switched off. The deadlines of all zones are
+	kept in a binary min-heap and one kernel timer is always set for
+	the earliest, so the number of zones costs no extra timers and
+	a touch is O(log n).
+
+	Wesley Fung (fungw@tcd.ie)
+*/
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+#include "zones.h"
+#include "occupancy.h"
+
+#define occupancyNOT_QUEUED		0xFFFF
+
+#if occupancyMAX_ZONES >= occupancyNOT_QUEUED
+#error "occupancyMAX_ZONES must stay below occupancyNOT_QUEUED"
+#endif
+
+static portTickType xTimeout[occupancyMAX_ZONES];
+static portTickType xDeadline[occupancyMAX_ZONES];
+static unsigned char ucStage[occupancyMAX_ZONES];
+
+/* Heap of zones ordered by deadline, and each zone's place in it */
+static unsigned short usHeap[occupancyMAX_ZONES];
+static unsigned short usHeapPos[occupancyMAX_ZONES];
+static unsigned portBASE_TYPE uxHeapSize;
+
+static TimerHandle_t xOccupancyTimer;
+static OccupancyHandler pxStageHandler;
+/* The timer queue was full when the timer was last moved */
+static volatile portBASE_TYPE xRearmPending;
+
+/* Deadline a before deadline b, allowing for tick wrap */
+#define occupancyBEFORE( a, b )	( ( long ) ( ( a ) - ( b ) ) < 0 )
+
+static void prvTimerCallback( TimerHandle_t xTimer );
+
+/*
+	prvSwap()
+	- Description: Swaps two heap slots
+	- Parameters: i, j - slots
+*/
+static void prvSwap( unsigned portBASE_TYPE i, unsigned portBASE_TYPE j ) {
+	unsigned short zone = usHeap[i];
+
+	usHeap[i] = usHeap[j];
+	usHeap[j] = zone;
+	usHeapPos[usHeap[i]] = (unsigned short) i;
+	usHeapPos[usHeap[j]] = (unsigned short) j;
+}
+
+/*
+	prvSiftUp() / prvSiftDown()
+	- Description: Restore heap order after a slot's deadline moved
+	earlier / later
+	- Parameters: i - slot
+*/
+static void prvSiftUp( unsigned portBASE_TYPE i ) {
+	while ((i > 0) && occupancyBEFORE(xDeadline[usHeap[i]], xDeadline[usHeap[(i - 1) / 2]])) {
+		prvSwap(i, (i - 1) / 2);
+		i = (i - 1) / 2;
+	}
+}
+
+static void prvSiftDown( unsigned portBASE_TYPE i ) {
+	unsigned portBASE_TYPE child;
+
+	for (;;) {
+		child = i * 2 + 1;
+		if (child >= uxHeapSize) {
+			return;
+		}
+		if ((child + 1 < uxHeapSize) && occupancyBEFORE(xDeadline[usHeap[child + 1]], xDeadline[usHeap[child]])) {
+			child++;
+		}
+		if (!occupancyBEFORE(xDeadline[usHeap[child]], xDeadline[usHeap[i]])) {
+			return;
+		}
+		prvSwap(i, child);
+		i = child;
+	}
+}
+
+/*
+	prvSchedule()
+	- Description: Gives a zone a new deadline, queueing it if needed
+	- Parameters: zone - zone number
+								xWhen - deadline (tick)
+*/
+static void prvSchedule( unsigned portBASE_TYPE zone, portTickType xWhen ) {
+	unsigned portBASE_TYPE i = usHeapPos[zone];
+
+	xDeadline[zone] = xWhen;
+	if (i == occupancyNOT_QUEUED) {
+		i = uxHeapSize++;
+		usHeap[i] = (unsigned short) zone;
+		usHeapPos[zone] = (unsigned short) i;
+	}
+	prvSiftUp(i);
+	prvSiftDown(usHeapPos[zone]);
+}
+
+/*
+	prvUnschedule()
+	- Description: Takes a zone out of the heap
+	- Parameters: zone - zone number
+*/
+static void prvUnschedule( unsigned portBASE_TYPE zone ) {
+	unsigned portBASE_TYPE i = usHeapPos[zone];
+
+	if (i == occupancyNOT_QUEUED) {
+		return;
+	}
+	uxHeapSize--;
+	if (i != uxHeapSize) {
+		prvSwap(i, uxHeapSize);
+	}
+	usHeapPos[zone] = occupancyNOT_QUEUED;
+	if (i < uxHeapSize) {
+		prvSiftUp(i);
+		prvSiftDown(i);
+	}
+}
+
+/*
+	prvRearm()
+	- Description: Points the timer at the earliest deadline, or
+	stops it if no zone is waiting. Called outside critical sections
+	since it posts to the timer service queue. If the queue is full
+	the next touch, clear or poll tries again.
+	- Parameters: xBlock - ticks to wait for room on the timer queue
+*/
+static void prvRearm( portTickType xBlock ) {
+	portTickType xWhen = 0, xNow;
+	portBASE_TYPE xWaiting, xSent;
+
+	portENTER_CRITICAL();
+	xWaiting = (uxHeapSize != 0);
+	if (xWaiting) {
+		xWhen = xDeadline[usHeap[0]];
+	}
+	xRearmPending = pdFALSE;
+	portEXIT_CRITICAL();
+
+	if (!xWaiting) {
+		xSent = xTimerStop(xOccupancyTimer, xBlock);
+	} else {
+		xNow = xTaskGetTickCount();
+		xSent = xTimerChangePeriod(xOccupancyTimer, occupancyBEFORE(xNow, xWhen) ? (xWhen - xNow) : 1, xBlock);
+	}
+	if (xSent != pdPASS) {
+		xRearmPending = pdTRUE;
+	}
+}
+
+/*
+	vStartOccupancy()
+	- Description: Creates the timer. Every zone starts idle with
+	the default timeout.
+	- Parameters: pxHandler - called when a zone is dimmed
+	(occupancyDIMMED) or switched off (occupancyIDLE) for vacancy
+*/
+void vStartOccupancy( OccupancyHandler pxHandler ) {
+	unsigned portBASE_TYPE zone;
+
+	for (zone = 0; zone < occupancyMAX_ZONES; zone++) {
+		xTimeout[zone] = occupancyDEFAULT_MS / portTICK_RATE_MS;
+		ucStage[zone] = occupancyIDLE;
+		usHeapPos[zone] = occupancyNOT_QUEUED;
+	}
+	uxHeapSize = 0;
+	pxStageHandler = pxHandler;
+	xOccupancyTimer = xTimerCreate("Occupancy", 1, pdFALSE, (void *) 0, prvTimerCallback);
+}
+
+/*
+	vOccupancySetTimeout()
+	- Description: Changes a zone's vacancy timeout; takes effect at
+	its next touch
+	- Parameters: zone - zone number
+								xTicks - ticks without a touch before dimming
+*/
+void vOccupancySetTimeout( unsigned portBASE_TYPE zone, portTickType xTicks ) {
+	xTimeout[zone] = xTicks;
+}
+
+/*
+	vOccupancyTouch()
+	- Description: The zone is in use: restart its vacancy timeout
+	- Parameters: zone - zone number
+*/
+void vOccupancyTouch( unsigned portBASE_TYPE zone ) {
+	portBASE_TYPE xFirst;
+
+	portENTER_CRITICAL();
+	ucStage[zone] = occupancyOCCUPIED;
+	prvSchedule(zone, xTaskGetTickCount() + xTimeout[zone]);
+	xFirst = (usHeap[0] == zone);
+	portEXIT_CRITICAL();
+
+	/* Only a new earliest deadline moves the timer */
+	if (xFirst || xRearmPending) {
+		prvRearm(0);
+	}
+}
+
+/*
+	vOccupancyClear()
+	- Description: The zone is off: stop tracking it
+	- Parameters: zone - zone number
+*/
+void vOccupancyClear( unsigned portBASE_TYPE zone ) {
+	portBASE_TYPE xWasFirst;
+
+	portENTER_CRITICAL();
+	xWasFirst = (usHeapPos[zone] == 0);
+	ucStage[zone] = occupancyIDLE;
+	prvUnschedule(zone);
+	portEXIT_CRITICAL();
+
+	if (xWasFirst || xRearmPending) {
+		prvRearm(0);
+	}
+}
+
+/*
+	vOccupancyPoll()
+	- Description: Moves the timer if the timer queue was full the
+	last time; call it regularly from a task
+	- Parameters: N/A
+*/
+void vOccupancyPoll( void ) {
+	if (xRearmPending) {
+		prvRearm(0);
+	}
+}
+
+/*
+	ucOccupancyStage()
+	- Description: Stage a zone is at
+	- Parameters: zone - zone number
+*/
+unsigned char ucOccupancyStage( unsigned portBASE_TYPE zone ) {
+	return ucStage[zone];
+}
+
+/*
+	prvTimerCallback()
+	- Description: Moves every zone whose deadline has passed on a
+	stage (occupied -> dimmed -> idle), reports it, and sets the
+	timer for the next deadline
+	- Parameters: xTimer - the occupancy timer
+*/
+static void prvTimerCallback( TimerHandle_t xTimer ) {
+	portTickType xNow = xTaskGetTickCount();
+	unsigned portBASE_TYPE zone;
+	unsigned char stage;
+
+	( void ) xTimer;
+
+	for (;;) {
+		portENTER_CRITICAL();
+		if ((uxHeapSize == 0) || occupancyBEFORE(xNow, xDeadline[usHeap[0]])) {
+			portEXIT_CRITICAL();
+			break;
+		}
+		zone = usHeap[0];
+		if (ucStage[zone] == occupancyOCCUPIED) {
+			ucStage[zone] = occupancyDIMMED;
+			prvSchedule(zone, xNow + occupancyGRACE_MS / portTICK_RATE_MS);
+		} else {
+			ucStage[zone] = occupancyIDLE;
+			prvUnschedule(zone);
+		}
+		stage = ucStage[zone];
+		portEXIT_CRITICAL();
+
+		pxStageHandler(zone, stage);
+	}
+	prvRearm(0);
+}
@@ -0,0 +1,28 @@
+#ifndef OCCUPANCY_H
+#define OCCUPANCY_H
+
+#include "FreeRTOS.h"
+
+/* Zones tracked (see zones.h) */
+#define occupancyMAX_ZONES		NUM_ZONES
+
+/* Default vacancy timeout, and how long a vacated zone stays dimmed (ms) */
+#define occupancyDEFAULT_MS		30000
+#define occupancyGRACE_MS		10000
+
+/* Zone stages */
+#define occupancyIDLE			0	/* off or not tracked */
+#define occupancyOCCUPIED		1	/* deadline is the vacancy timeout */
+#define occupancyDIMMED			2	/* deadline is switch off */
+
+/* Called from the timer service task when a zone reaches a stage */
+typedef void (*OccupancyHandler)( unsigned portBASE_TYPE zone, unsigned char stage );
+
+void vStartOccupancy( OccupancyHandler pxHandler );
+void vOccupancySetTimeout( unsigned portBASE_TYPE zone, portTickType xTimeout );
+void vOccupancyTouch( unsigned portBASE_TYPE zone );
+void vOccupancyClear( unsigned portBASE_TYPE zone );
+void vOccupancyPoll( void );
+unsigned char ucOccupancyStage( unsigned portBASE_TYPE zone );
+
+#endif
@@ -0,0 +1,436 @@
+/*
+	PCA9532 LED dimmer driver. Keeps a mirror of every register
+	so that writes only reach the bus when a byte actually changes.
+	Callers stage new values with vPCA9532Set() and push all staged
+	changes with xPCA9532Flush().
+
+	Any number of PCA9532 (or compatible) expanders can share the
+	bus; they are addressed by their index in ucDeviceAddress[]
+	and each has its own mirror.
+
+	Wesley Fung (fungw@tcd.ie)
+*/
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include <stdio.h>
+#include "i2c.h"
+#include "pca9532.h"
+#include "evlog.h"
+
+/* Slave addresses of the expanders on the bus, by device index */
+static const unsigned char ucDeviceAddress[PCA9532_NUM_DEVICES] = {
+	PCA9532_ADDRESS
+};
+
+/* Register values as last written to (or read from) each chip */
+static unsigned char ucHardware[PCA9532_NUM_DEVICES][PCA9532_NUM_REGISTERS];
+/* Register values the application wants; differ only while dirty */
+static unsigned char ucPending[PCA9532_NUM_DEVICES][PCA9532_NUM_REGISTERS];
+/* Bit n set when register n of a device has a pending write */
+static unsigned short usDirty[PCA9532_NUM_DEVICES];
+/* Incremented before and after each burst; odd while a write is on the bus */
+static volatile unsigned long ulWriteSeq[PCA9532_NUM_DEVICES];
+/* First register driven by someone else (see vPCA9532Detach()); the
+   mirror neither writes nor checks it or any register above it */
+static unsigned char ucDetachFrom[PCA9532_NUM_DEVICES];
+
+/* Serialises flushes so a stale snapshot is never written last */
+static xSemaphoreHandle xFlushLock;
+
+/* Statistics */
+static unsigned long ulWrites;
+static unsigned long ulBytes;
+static unsigned long ulElided;
+static unsigned long ulDrift;
+
+/*
+	vPCA9532Init()
+	- Description: Initialises the register mirror to the PCA9532
+	power-on defaults. Must be called before the scheduler starts.
+	- Parameters: N/A
+*/
+void vPCA9532Init( void ) {
+	unsigned portBASE_TYPE dev;
+	unsigned char reg;
+
+	for (dev = 0; dev < PCA9532_NUM_DEVICES; dev++) {
+		for (reg = 0; reg < PCA9532_NUM_REGISTERS; reg++) {
+			ucHardware[dev][reg] = 0x00;
+		}
+		ucHardware[dev][PCA9532_PWM0] = 0x80;
+		ucHardware[dev][PCA9532_PWM1] = 0x80;
+		for (reg = 0; reg < PCA9532_NUM_REGISTERS; reg++) {
+			ucPending[dev][reg] = ucHardware[dev][reg];
+		}
+		usDirty[dev] = 0;
+		ucDetachFrom[dev] = PCA9532_NUM_REGISTERS;
+	}
+	ulWrites = 0;
+	ulBytes = 0;
+	ulElided = 0;
+	ulDrift = 0;
+
+	vSemaphoreCreateBinary(xFlushLock);
+}
+
+/*
+	ucPCA9532Get()
+	- Description: Value of a register as the application last set it
+	- Parameters: dev - device index
+								reg - register
+*/
+unsigned char ucPCA9532Get( unsigned portBASE_TYPE dev, unsigned char reg ) {
+	return ucPending[dev][reg];
+}
+
+/*
+	prvStage()
+	- Description: Records a new pending value; caller holds the
+	critical section
+	- Parameters: dev - device index
+								reg - register
+								value - byte to write
+*/
+static void prvStage( unsigned portBASE_TYPE dev, unsigned char reg, unsigned char value ) {
+	ucPending[dev][reg] = value;
+	if (value == ucHardware[dev][reg]) {
+		usDirty[dev] &= ~(1 << reg);
+		ulElided++;
+	} else {
+		usDirty[dev] |= (1 << reg);
+	}
+}
+
+/*
+	vPCA9532Set()
+	- Description: Stages a register write. Nothing goes on the bus
+	until xPCA9532Flush(), and nothing at all if the chip already
+	holds the value.
+	- Parameters: dev - device index
+								reg - register
+								value - byte to write
+*/
+void vPCA9532Set( unsigned portBASE_TYPE dev, unsigned char reg, unsigned char value ) {
+	portENTER_CRITICAL();
+	prvStage(dev, reg, value);
+	portEXIT_CRITICAL();
+}
+
+/*
+	vPCA9532SetBits()
+	- Description: Stages a read-modify-write of some bits of a
+	register, atomically with respect to other tasks
+	- Parameters: dev - device index
+								reg - register
+								mask - bits to change
+								value - new value of those bits
+*/
+void vPCA9532SetBits( unsigned portBASE_TYPE dev, unsigned char reg, unsigned char mask, unsigned char value ) {
+	portENTER_CRITICAL();
+	prvStage(dev, reg, (ucPending[dev][reg] & ~mask) | (value & mask));
+	portEXIT_CRITICAL();
+}
+
+/*
+	prvFlushDevice()
+	- Description: Writes every dirty register of one device in a
+	single auto-increment burst spanning the lowest to the highest
+	dirty register. A register is only marked clean if it was not
+	set again while the write was in progress. Detached registers
+	stay dirty until they are attached again. Caller holds the
+	flush lock.
+	- Parameters: dev - device index
+	- Returns: pdFAIL if the write was not acknowledged
+*/
+static portBASE_TYPE prvFlushDevice( unsigned portBASE_TYPE dev ) {
+	unsigned char data[PCA9532_NUM_REGISTERS];
+	unsigned char reg;
+	unsigned char first;
+	unsigned char last;
+	unsigned short usWrite;
+	portBASE_TYPE xReturn;
+
+	portENTER_CRITICAL();
+	usWrite = usDirty[dev] & ((1 << ucDetachFrom[dev]) - 1);
+	if (usWrite == 0) {
+		portEXIT_CRITICAL();
+		return pdPASS;
+	}
+	for (first = 0; (usWrite & (1 << first)) == 0; first++);
+	for (last = PCA9532_NUM_REGISTERS - 1; (usWrite & (1 << last)) == 0; last--);
+	for (reg = first; reg <= last; reg++) {
+		data[reg - first] = ucPending[dev][reg];
+	}
+	portEXIT_CRITICAL();
+
+	ulWriteSeq[dev]++;
+	xReturn = xPCA9532WriteBurst(dev, first, data, last - first + 1);
+	if (xReturn == pdPASS) {
+		portENTER_CRITICAL();
+		for (reg = first; reg <= last; reg++) {
+			ucHardware[dev][reg] = data[reg - first];
+			if (ucPending[dev][reg] == data[reg - first]) {
+				usDirty[dev] &= ~(1 << reg);
+			}
+		}
+		portEXIT_CRITICAL();
+	}
+	ulWriteSeq[dev]++;
+	return xReturn;
+}
+
+/*
+	xPCA9532Flush()
+	- Description: Pushes all staged changes, grouped per device:
+	one transaction for each device that has anything dirty.
+	- Parameters: N/A
+	- Returns: pdFAIL if any device did not acknowledge
+*/
+portBASE_TYPE xPCA9532Flush( void ) {
+	unsigned portBASE_TYPE dev;
+	portBASE_TYPE xReturn = pdPASS;
+
+	xSemaphoreTake(xFlushLock, portMAX_DELAY);
+	for (dev = 0; dev < PCA9532_NUM_DEVICES; dev++) {
+		if (prvFlushDevice(dev) != pdPASS) {
+			xReturn = pdFAIL;
+		}
+	}
+	xSemaphoreGive(xFlushLock);
+	return xReturn;
+}
+
+/*
+	xPCA9532WriteBurst()
+	- Description: Writes consecutive registers in one addressed
+	transaction using the auto-increment control bit. Bypasses
+	the mirror; use vPCA9532Set()/xPCA9532Flush() for cached writes.
+	- Parameters: dev - device index
+								reg - first register
+								data - values for reg, reg + 1, ...
+								length - number of registers
+*/
+portBASE_TYPE xPCA9532WriteBurst( unsigned portBASE_TYPE dev, unsigned char reg, const unsigned char *data, unsigned int length ) {
+	unsigned char buffer[1 + PCA9532_NUM_REGISTERS];
+	I2CTransfer xfer;
+
+	if ((length == 0) || (length > PCA9532_NUM_REGISTERS)) {
+		return pdFAIL;
+	}
+
+	vPCA9532Describe(dev, reg, data, length, &xfer, buffer);
+	vEvLogRecord(evlogI2C_WRITE, ((unsigned long) dev << 16) | ((unsigned long) reg << 8) | length);
+	if (xI2CTransfer(&xfer, i2cPRIORITY_NORMAL) != i2cOK) {
+		return pdFAIL;
+	}
+	ulWrites++;
+	ulBytes += length;
+	return pdPASS;
+}
+
+/*
+	vPCA9532Describe()
+	- Description: Builds the transaction for a burst write without
+	running it, for callers that start it themselves (e.g. from an
+	interrupt with xI2CTransferFromISR()). Bypasses the mirror.
+	- Parameters: dev - device index
+								reg - first register
+								data - values for reg, reg + 1, ...
+								length - number of registers (1 to 10)
+								pxTransfer - receives the transaction
+								pucBuffer - length + 1 bytes for the bytes sent;
+								must outlive the transfer
+*/
+void vPCA9532Describe( unsigned portBASE_TYPE dev, unsigned char reg, const unsigned char *data, unsigned int length, I2CTransfer *pxTransfer, unsigned char *pucBuffer ) {
+	unsigned int i;
+
+	pucBuffer[0] = PCA9532_AUTO_INCREMENT | reg;
+	for (i = 0; i < length; i++) {
+		pucBuffer[i + 1] = data[i];
+	}
+
+	pxTransfer->address = ucDeviceAddress[dev];
+	pxTransfer->txData = pucBuffer;
+	pxTransfer->txLength = length + 1;
+	pxTransfer->rxData = NULL;
+	pxTransfer->rxLength = 0;
+}
+
+/*
+	vPCA9532Detach()
+	- Description: Hands a register and every register above it
+	over to another writer (e.g. an interrupt). Until they are
+	attached again flushes leave them alone, even if dirty, and
+	polls do not count what they read there as drift.
+	- Parameters: dev - device index
+								reg - first register handed over
+*/
+void vPCA9532Detach( unsigned portBASE_TYPE dev, unsigned char reg ) {
+	portENTER_CRITICAL();
+	ucDetachFrom[dev] = reg;
+	portEXIT_CRITICAL();
+}
+
+/*
+	vPCA9532Attach()
+	- Description: Takes detached registers back. The mirror takes
+	data as what the chip now holds and marks every register whose
+	pending value differs dirty, for the next flush. A write of the
+	other writer that lands later is put right by the drift check.
+	- Parameters: dev - device index
+								data - last values written from the first
+								detached register up to LS3, or NULL if not
+								known; every register is then marked dirty
+*/
+void vPCA9532Attach( unsigned portBASE_TYPE dev, const unsigned char *data ) {
+	unsigned char reg;
+
+	portENTER_CRITICAL();
+	for (reg = ucDetachFrom[dev]; reg < PCA9532_NUM_REGISTERS; reg++) {
+		if (data == NULL) {
+			usDirty[dev] |= (1 << reg);
+			continue;
+		}
+		ucHardware[dev][reg] = *data++;
+		if (ucPending[dev][reg] != ucHardware[dev][reg]) {
+			usDirty[dev] |= (1 << reg);
+		} else {
+			usDirty[dev] &= ~(1 << reg);
+		}
+	}
+	ucDetachFrom[dev] = PCA9532_NUM_REGISTERS;
+	portEXIT_CRITICAL();
+}
+
+/*
+	xPCA9532ApplyScene()
+	- Description: Stages prescalers, duty cycles and LED selectors
+	of one device together and flushes them in one transaction
+	- Parameters: dev - device index
+								pxScene - scene to apply
+*/
+portBASE_TYPE xPCA9532ApplyScene( unsigned portBASE_TYPE dev, const PCA9532Scene *pxScene ) {
+	unsigned char i;
+
+	vPCA9532Set(dev, PCA9532_PSC0, pxScene->psc0);
+	vPCA9532Set(dev, PCA9532_PWM0, pxScene->pwm0);
+	vPCA9532Set(dev, PCA9532_PSC1, pxScene->psc1);
+	vPCA9532Set(dev, PCA9532_PWM1, pxScene->pwm1);
+	for (i = 0; i < 4; i++) {
+		vPCA9532Set(dev, PCA9532_LS0 + i, pxScene->ls[i]);
+	}
+	return xPCA9532Flush();
+}
+
+/*
+	xPCA9532Write()
+	- Description: Sets one register and flushes immediately
+	- Parameters: dev - device index
+								reg - register
+								value - byte to write
+*/
+portBASE_TYPE xPCA9532Write( unsigned portBASE_TYPE dev, unsigned char reg, unsigned char value ) {
+	vPCA9532Set(dev, reg, value);
+	return xPCA9532Flush();
+}
+
+/*
+	ucPCA9532ReadInput()
+	- Description: Reads an input register from the chip. Input
+	reads are urgent and overtake queued LED writes. If the read
+	fails the last value read is returned.
+	- Parameters: dev - device index
+								reg - PCA9532_INPUT0 or PCA9532_INPUT1
+*/
+unsigned char ucPCA9532ReadInput( unsigned portBASE_TYPE dev, unsigned char reg ) {
+	unsigned char data = 0;
+	I2CTransfer xfer;
+
+	/* Write control word, repeated START, read one byte */
+	xfer.address = ucDeviceAddress[dev];
+	xfer.txData = &reg;
+	xfer.txLength = 1;
+	xfer.rxData = &data;
+	xfer.rxLength = 1;
+	if (xI2CTransfer(&xfer, i2cPRIORITY_URGENT) == i2cOK) {
+		ucHardware[dev][reg] = data;
+		ucPending[dev][reg] = data;
+	}
+	return ucHardware[dev][reg];
+}
+
+/*
+	xPCA9532Poll()
+	- Description: Reads INPUT0, INPUT1 and every output register
+	(PSC0..LS3) in one auto-increment transaction, and checks the
+	outputs against the mirror at no extra bus cost. A register
+	that does not hold what the mirror says (e.g. after a chip
+	reset) is counted as drift and marked dirty, so the next flush
+	puts the intended value back. The check is skipped if a write
+	to the device overlapped the read, and for detached registers.
+	- Parameters: dev - device index
+								pucInputs - receives INPUT0 and INPUT1
+	- Returns: pdFAIL if the read failed; pucInputs then holds the
+	last values read
+*/
+portBASE_TYPE xPCA9532Poll( unsigned portBASE_TYPE dev, unsigned char *pucInputs ) {
+	unsigned char control = PCA9532_AUTO_INCREMENT | PCA9532_INPUT0;
+	unsigned char data[PCA9532_NUM_REGISTERS];
+	unsigned long ulSeq;
+	unsigned char reg;
+	portBASE_TYPE xReturn = pdFAIL;
+	I2CTransfer xfer;
+
+	ulSeq = ulWriteSeq[dev];
+
+	xfer.address = ucDeviceAddress[dev];
+	xfer.txData = &control;
+	xfer.txLength = 1;
+	xfer.rxData = data;
+	xfer.rxLength = PCA9532_NUM_REGISTERS;
+	if (xI2CTransfer(&xfer, i2cPRIORITY_URGENT) == i2cOK) {
+		portENTER_CRITICAL();
+		ucHardware[dev][PCA9532_INPUT0] = data[PCA9532_INPUT0];
+		ucHardware[dev][PCA9532_INPUT1] = data[PCA9532_INPUT1];
+		if (((ulSeq & 1) == 0) && (ulSeq == ulWriteSeq[dev])) {
+			for (reg = PCA9532_PSC0; reg < ucDetachFrom[dev]; reg++) {
+				if (data[reg] != ucHardware[dev][reg]) {
+					ucHardware[dev][reg] = data[reg];
+					if (ucPending[dev][reg] != data[reg]) {
+						usDirty[dev] |= (1 << reg);
+					} else {
+						usDirty[dev] &= ~(1 << reg);
+					}
+					ulDrift++;
+				}
+			}
+		}
+		portEXIT_CRITICAL();
+		xReturn = pdPASS;
+	}
+
+	pucInputs[0] = ucHardware[dev][PCA9532_INPUT0];
+	pucInputs[1] = ucHardware[dev][PCA9532_INPUT1];
+	return xReturn;
+}
+
+/*
+	ulPCA9532WritesElided()
+	- Description: Number of register writes that were dropped
+	because the chip already held the value
+	- Parameters: N/A
+*/
+unsigned long ulPCA9532WritesElided( void ) {
+	return ulElided;
+}
+
+/*
+	vPCA9532PrintStats()
+	- Description: Prints the write/elision/drift counters on the console
+	- Parameters: N/A
+*/
+void vPCA9532PrintStats( void ) {
+	printf("PCA9532: %lu writes (%lu bytes), %lu elided, %lu drifted\r\n", ulWrites, ulBytes, ulElided, ulDrift);
+}
@@ -0,0 +1,61 @@
+#ifndef PCA9532_H
+#define PCA9532_H
+
+#include "FreeRTOS.h"
+#include "i2c.h"
+
+/* PCA9532 slave address on the EA board */
+#define PCA9532_ADDRESS		0xC0
+
+/* Expanders on the bus (see ucDeviceAddress[] in pca9532.c) */
+#define PCA9532_NUM_DEVICES	1
+#define PCA9532_NUM_PINS	16
+
+/* PCA9532 registers (control word values) */
+#define PCA9532_INPUT0		0x00
+#define PCA9532_INPUT1		0x01
+#define PCA9532_PSC0		0x02
+#define PCA9532_PWM0		0x03
+#define PCA9532_PSC1		0x04
+#define PCA9532_PWM1		0x05
+#define PCA9532_LS0			0x06
+#define PCA9532_LS1			0x07
+#define PCA9532_LS2			0x08
+#define PCA9532_LS3			0x09
+#define PCA9532_NUM_REGISTERS	10
+
+/* Control word bit: register address increments after each byte */
+#define PCA9532_AUTO_INCREMENT	0x10
+
+/* LED selector values, two bits per pin in LS0..LS3 */
+#define PCA9532_LED_OFF		0x00
+#define PCA9532_LED_ON		0x01
+#define PCA9532_LED_PWM0	0x02
+#define PCA9532_LED_PWM1	0x03
+
+/* Complete output configuration, PSC0..LS3 in register order */
+typedef struct PCA9532Scene {
+	unsigned char psc0;
+	unsigned char pwm0;
+	unsigned char psc1;
+	unsigned char pwm1;
+	unsigned char ls[4];
+} PCA9532Scene;
+
+void vPCA9532Init( void );
+unsigned char ucPCA9532Get( unsigned portBASE_TYPE dev, unsigned char reg );
+void vPCA9532Set( unsigned portBASE_TYPE dev, unsigned char reg, unsigned char value );
+void vPCA9532SetBits( unsigned portBASE_TYPE dev, unsigned char reg, unsigned char mask, unsigned char value );
+portBASE_TYPE xPCA9532Flush( void );
+portBASE_TYPE xPCA9532Write( unsigned portBASE_TYPE dev, unsigned char reg, unsigned char value );
+portBASE_TYPE xPCA9532WriteBurst( unsigned portBASE_TYPE dev, unsigned char reg, const unsigned char *data, unsigned int length );
+void vPCA9532Describe( unsigned portBASE_TYPE dev, unsigned char reg, const unsigned char *data, unsigned int length, I2CTransfer *pxTransfer, unsigned char *pucBuffer );
+void vPCA9532Detach( unsigned portBASE_TYPE dev, unsigned char reg );
+void vPCA9532Attach( unsigned portBASE_TYPE dev, const unsigned char *data );
+portBASE_TYPE xPCA9532ApplyScene( unsigned portBASE_TYPE dev, const PCA9532Scene *pxScene );
+unsigned char ucPCA9532ReadInput( unsigned portBASE_TYPE dev, unsigned char reg );
+portBASE_TYPE xPCA9532Poll( unsigned portBASE_TYPE dev, unsigned char *pucInputs );
+unsigned long ulPCA9532WritesElided( void );
+void vPCA9532PrintStats( void );
+
+#endif
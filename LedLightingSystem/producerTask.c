@@ -80,7 +80,7 @@ static portTASK_FUNCTION( vProducerTask, pvParameters )
 	{
 		/* Delay for a second; modify command to invert the LED; send to Q */
 		vTaskDelayUntil(&xLastWakeTime, pConfig->period);
-		cmd.value = cmd.value == LED_ON ? LED_OFF : LED_ON;
+		cmd = cmdPACK(cmdSWITCH, 0, cmdVALUE(cmd) == LED_ON ? LED_OFF : LED_ON, 0);
 		xQueueSendToBack(pConfig->cmdQ, &cmd, portMAX_DELAY);
 	}
 }
@@ -0,0 +1,240 @@
+/*
+	Single producer, single consumer ring. The producer only ever
+	writes uxHead and the consumer only ever writes uxTail, both
+	free running counts, so neither side needs a critical section:
+	an item is copied in or out first and the count moved after it,
+	and the other side never looks at a slot until the count says it
+	may. Only the barrier between the two stops the compiler moving
+	the copy past the count; the ARM7 core does not reorder memory
+	accesses.
+
+	A reader that finds the ring empty records itself in xReader and
+	waits for its notification bits; the producer notifies it after
+	each put while it is recorded. Puts to a full ring are refused
+	and counted.
+
+	Wesley Fung (fungw@tcd.ie)
+*/
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include <stdio.h>
+#include <string.h>
+#include "ring.h"
+#include "hrtime.h"
+
+/* Stops the compiler moving buffer accesses across a count update */
+#if defined( __CC_ARM )
+	#define ringBARRIER()		__memory_changed()
+#else
+	#define ringBARRIER()		__asm volatile ( "" ::: "memory" )
+#endif
+
+/*
+	vRingInit()
+	- Description: Initialises an empty ring
+	- Parameters: pxRing - ring
+								pvBuffer - uxLength * uxItemSize bytes
+								uxLength - items; a power of two
+								uxItemSize - bytes per item
+								ulNotifyBits - bits set in the reader's
+								notification value when an item is put
+*/
+void vRingInit( Ring *pxRing, void *pvBuffer, unsigned portBASE_TYPE uxLength, unsigned portBASE_TYPE uxItemSize, unsigned long ulNotifyBits ) {
+	pxRing->pucBuffer = (unsigned char *) pvBuffer;
+	pxRing->uxItemSize = uxItemSize;
+	pxRing->uxMask = uxLength - 1;
+	pxRing->uxHead = 0;
+	pxRing->uxTail = 0;
+	pxRing->xReader = NULL;
+	pxRing->ulNotifyBits = ulNotifyBits;
+	pxRing->ulDropped = 0;
+}
+
+/*
+	xRingPutFromISR()
+	- Description: Puts an item; the producer side. Never blocks.
+	- Parameters: pxRing - ring
+								pvItem - item to copy in
+								pxHigherPriorityTaskWoken - set if the reader was woken
+	- Returns: pdPASS, or pdFAIL if the ring is full
+*/
+portBASE_TYPE xRingPutFromISR( Ring *pxRing, const void *pvItem, portBASE_TYPE *pxHigherPriorityTaskWoken ) {
+	unsigned portBASE_TYPE uxHead = pxRing->uxHead;
+	xTaskHandle xReader;
+
+	if ((uxHead - pxRing->uxTail) > pxRing->uxMask) {
+		pxRing->ulDropped++;
+		return pdFAIL;
+	}
+	memcpy(&pxRing->pucBuffer[(uxHead & pxRing->uxMask) * pxRing->uxItemSize], pvItem, pxRing->uxItemSize);
+	ringBARRIER();
+	pxRing->uxHead = uxHead + 1;
+
+	xReader = pxRing->xReader;
+	if (xReader != NULL) {
+		xTaskNotifyFromISR(xReader, pxRing->ulNotifyBits, eSetBits, pxHigherPriorityTaskWoken);
+	}
+	return pdPASS;
+}
+
+/*
+	xRingGet()
+	- Description: Takes the oldest item; the consumer side. Must be
+	called from a task.
+	- Parameters: pxRing - ring
+								pvItem - receives the item
+								xTicksToWait - how long to wait for one
+	- Returns: pdPASS, or pdFAIL if none arrived in time
+*/
+portBASE_TYPE xRingGet( Ring *pxRing, void *pvItem, portTickType xTicksToWait ) {
+	unsigned portBASE_TYPE uxTail;
+	TimeOut_t xTimeOut;
+
+	vTaskSetTimeOutState(&xTimeOut);
+	for (;;) {
+		uxTail = pxRing->uxTail;
+		if (pxRing->uxHead != uxTail) {
+			memcpy(pvItem, &pxRing->pucBuffer[(uxTail & pxRing->uxMask) * pxRing->uxItemSize], pxRing->uxItemSize);
+			ringBARRIER();
+			pxRing->uxTail = uxTail + 1;
+			return pdPASS;
+		}
+		if (xTaskCheckForTimeOut(&xTimeOut, &xTicksToWait) != pdFALSE) {
+			return pdFAIL;
+		}
+
+		/* Look again once recorded, or a put in between would be missed */
+		pxRing->xReader = xTaskGetCurrentTaskHandle();
+		if (pxRing->uxHead == uxTail) {
+			xTaskNotifyWait(0, pxRing->ulNotifyBits, NULL, xTicksToWait);
+		}
+		pxRing->xReader = NULL;
+	}
+}
+
+#if ringBENCHMARK == 1
+
+/* Items per burst, bursts per size, and the largest item */
+#define ringBENCH_LENGTH		16
+#define ringBENCH_BURSTS		64
+#define ringBENCH_MAX_ITEM		16
+
+/* CPU cycles per high resolution count */
+#define ringCYCLES_PER_COUNT	( configCPU_CLOCK_HZ / configPERIPHERAL_CLOCK_HZ )
+
+static unsigned char ucBenchBuffer[ringBENCH_LENGTH * ringBENCH_MAX_ITEM];
+
+/*
+	prvBenchQueue()
+	- Description: Times bursts of xQueueSendToBackFromISR() with
+	interrupts masked, as in an ISR, each emptied by xQueueReceive()
+	- Parameters: uxItemSize - bytes per item
+								pulPut - receives the counts for all puts
+								pulGet - receives the counts for all gets
+	- Returns: pdPASS, or pdFAIL if the queue could not be created
+*/
+static portBASE_TYPE prvBenchQueue( unsigned portBASE_TYPE uxItemSize, unsigned long *pulPut, unsigned long *pulGet ) {
+	xQueueHandle xQueue = xQueueCreate(ringBENCH_LENGTH, uxItemSize);
+	unsigned char ucItem[ringBENCH_MAX_ITEM];
+	portBASE_TYPE xWoken = pdFALSE;
+	unsigned portBASE_TYPE uxBurst, i;
+	unsigned long ulStart;
+
+	if (xQueue == NULL) {
+		return pdFAIL;
+	}
+	memset(ucItem, 0x5A, sizeof(ucItem));
+	*pulPut = 0;
+	*pulGet = 0;
+	for (uxBurst = 0; uxBurst < ringBENCH_BURSTS; uxBurst++) {
+		portENTER_CRITICAL();
+		ulStart = ulHRTimeGet();
+		for (i = 0; i < ringBENCH_LENGTH; i++) {
+			xQueueSendToBackFromISR(xQueue, ucItem, &xWoken);
+		}
+		*pulPut += ulHRTimeGet() - ulStart;
+		portEXIT_CRITICAL();
+
+		ulStart = ulHRTimeGet();
+		for (i = 0; i < ringBENCH_LENGTH; i++) {
+			xQueueReceive(xQueue, ucItem, 0);
+		}
+		*pulGet += ulHRTimeGet() - ulStart;
+	}
+	vQueueDelete(xQueue);
+	return pdPASS;
+}
+
+/*
+	prvBenchRing()
+	- Description: Times the same bursts through a ring
+	- Parameters: uxItemSize - bytes per item
+								pulPut - receives the counts for all puts
+								pulGet - receives the counts for all gets
+*/
+static void prvBenchRing( unsigned portBASE_TYPE uxItemSize, unsigned long *pulPut, unsigned long *pulGet ) {
+	Ring xRing;
+	unsigned char ucItem[ringBENCH_MAX_ITEM];
+	portBASE_TYPE xWoken = pdFALSE;
+	unsigned portBASE_TYPE uxBurst, i;
+	unsigned long ulStart;
+
+	vRingInit(&xRing, ucBenchBuffer, ringBENCH_LENGTH, uxItemSize, 0);
+	memset(ucItem, 0x5A, sizeof(ucItem));
+	*pulPut = 0;
+	*pulGet = 0;
+	for (uxBurst = 0; uxBurst < ringBENCH_BURSTS; uxBurst++) {
+		portENTER_CRITICAL();
+		ulStart = ulHRTimeGet();
+		for (i = 0; i < ringBENCH_LENGTH; i++) {
+			xRingPutFromISR(&xRing, ucItem, &xWoken);
+		}
+		*pulPut += ulHRTimeGet() - ulStart;
+		portEXIT_CRITICAL();
+
+		ulStart = ulHRTimeGet();
+		for (i = 0; i < ringBENCH_LENGTH; i++) {
+			xRingGet(&xRing, ucItem, 0);
+		}
+		*pulGet += ulHRTimeGet() - ulStart;
+	}
+}
+
+/*
+	vRingBenchmark()
+	- Description: Prints the average CPU cycles to put an item from
+	an ISR and to take it in a task, for 1, 4 and 16 byte items, for
+	a queue and for a ring. No task waits, so neither wakes anyone.
+	Runs at the highest task priority. Each figure includes a share
+	of reading the timestamps.
+	- Parameters: N/A
+*/
+void vRingBenchmark( void ) {
+	static const unsigned portBASE_TYPE uxSizes[] = { 1, 4, ringBENCH_MAX_ITEM };
+	unsigned long ulQueuePut[3], ulQueueGet[3], ulRingPut[3], ulRingGet[3];
+	unsigned long ulItems = (unsigned long) ringBENCH_LENGTH * ringBENCH_BURSTS;
+	unsigned portBASE_TYPE i;
+	unsigned portBASE_TYPE uxPriority = uxTaskPriorityGet(NULL);
+
+	vTaskPrioritySet(NULL, configMAX_PRIORITIES - 1);
+	for (i = 0; i < 3; i++) {
+		if (prvBenchQueue(uxSizes[i], &ulQueuePut[i], &ulQueueGet[i]) == pdFAIL) {
+			vTaskPrioritySet(NULL, uxPriority);
+			printf("Ring benchmark: no memory for the queue\r\n");
+			return;
+		}
+		prvBenchRing(uxSizes[i], &ulRingPut[i], &ulRingGet[i]);
+	}
+	vTaskPrioritySet(NULL, uxPriority);
+
+	for (i = 0; i < 3; i++) {
+		printf("%2u byte items: queue put %lu get %lu, ring put %lu get %lu cycles\r\n",
+			(unsigned) uxSizes[i],
+			ulQueuePut[i] * ringCYCLES_PER_COUNT / ulItems, ulQueueGet[i] * ringCYCLES_PER_COUNT / ulItems,
+			ulRingPut[i] * ringCYCLES_PER_COUNT / ulItems, ulRingGet[i] * ringCYCLES_PER_COUNT / ulItems);
+	}
+}
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef RING_H
+#define RING_H
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Build the "ring" console benchmark */
+#define ringBENCHMARK			1
+
+/*
+	A ring of fixed size items between one producer and one consumer,
+	one of which may be an interrupt. The caller owns the ring and its
+	buffer; initialise it with vRingInit() and leave the fields alone
+	afterwards.
+*/
+typedef struct Ring {
+	unsigned char *pucBuffer;
+	unsigned portBASE_TYPE uxItemSize;
+	unsigned portBASE_TYPE uxMask;			/* length - 1; the length is a power of two */
+	volatile unsigned portBASE_TYPE uxHead;	/* items ever put; written by the producer only */
+	volatile unsigned portBASE_TYPE uxTail;	/* items ever taken; written by the consumer only */
+	volatile xTaskHandle xReader;			/* task waiting in xRingGet(), if any */
+	unsigned long ulNotifyBits;				/* notification bits that wake it */
+	volatile unsigned long ulDropped;		/* puts refused because the ring was full */
+} Ring;
+
+void vRingInit( Ring *pxRing, void *pvBuffer, unsigned portBASE_TYPE uxLength, unsigned portBASE_TYPE uxItemSize, unsigned long ulNotifyBits );
+portBASE_TYPE xRingPutFromISR( Ring *pxRing, const void *pvItem, portBASE_TYPE *pxHigherPriorityTaskWoken );
+portBASE_TYPE xRingGet( Ring *pxRing, void *pvItem, portTickType xTicksToWait );
+void vRingBenchmark( void );
+
+#endif
@@ -10,89 +10,117 @@
 #include "FreeRTOS.h"
 #include "task.h"
 #include "queue.h"
-#include "timers.h"
-#include "semphr.h"
 #include "lpc24xx.h"
 #include <stdio.h>
 #include <string.h>
 #include "commands.h"
 #include "sensors.h"
-
-#define I2C_AA      0x00000004
-#define I2C_SI      0x00000008
-#define I2C_STO     0x00000010
-#define I2C_STA     0x00000020
-#define I2C_I2EN    0x00000040
+#include "pca9532.h"
+#include "zones.h"
+#include "fade.h"
+#include "debounce.h"
+#include "gesture.h"
+#include "occupancy.h"
+#include "strobe.h"
+#include "bus.h"
+#include "coalesce.h"
 
 #define P210BIT ( ( unsigned long ) 0x4 )
 
+/* The UI buttons are inputs 0-3 of expander 0 */
+#define sensorsBUTTON_MASK			( ( unsigned short ) 0x000F )
+
 /* Maximum task stack size */
 #define sensorsSTACK_SIZE			( ( unsigned portBASE_TYPE ) 256 )
-	
-TimerHandle_t xTimerMotion;
-TimerHandle_t xTimerFire;
-TimerHandle_t xTimerClapClap;
-TimerHandle_t xTimerStartMotion;
 
-xQueueHandle xToLCDQ;
+/* Button polling periods (ticks) */
+static portTickType xPollFast = sensorsPOLL_FAST_MS / portTICK_RATE_MS;
+static portTickType xPollIdle = sensorsPOLL_IDLE_MS / portTICK_RATE_MS;
+static portTickType xActiveWindow = sensorsACTIVE_WINDOW_MS / portTICK_RATE_MS;
+
 xQueueHandle xCmdQ;
-xSemaphoreHandle xSensorSemphr;
 unsigned char STATE_P1 = 0x8F; // Default state for preset 1
 unsigned char STATE_P2 = 0x0B; // Default state for preset 2
 unsigned char STATE_FIRE1 = 0x44; // Alternating LED state 1
 unsigned char STATE_FIRE2 = 0x11; // Alternating LED state 2
-unsigned char PWM0 = 0xBF; // Set PWM0 duty cycle to 75%	(255 * 75%)
-unsigned char PWM1 = 0x40; // Set PWM1 duty cycle to 25%	(255 * 25%)
-int FIRE_STATE = 0;
+unsigned char PWM0 = 0xE0; // Bright dim level; gamma corrected to 75% duty
+unsigned char PWM1 = 0x88; // Low dim level; gamma corrected to 25% duty
+unsigned char PSC = 0x00; // Fastest PWM period (152 Hz) for both banks; no visible flicker
 int ON_FIRE = 0;
 unsigned char SHUTDOWN_STATE = 0x55;
-int clapClap = 0;
-int clapID;
-int PRESSED;
-int HELD = 1;
 unsigned char TIMEOUT_STATE_CALLBACK = 0xFF;
-int BUTTON_PRESSED;
-unsigned char CLAP_STATE;
-// Do not have same key codes for both.
-// Repeated individual keys OK.
-// Key codes correspond to button LED numbers, starting offset 0
-int FIRE_ACTIVATE_CODE[4] = { 3, 2, 1, 1 };
-int FIRE_DEACTIVATE_CODE[4] = { 2, 1, 4, 1};
-int FIRE_SAME_CODE = 1;
 
 /* The LCD task. */
 static void vSensorsTask( void *pvParameters );
 
-/* 
-	PIRTimeout()
-	- Description: Called when default time (30s) expires.
-	Timer resets. Pushes command onto corresponding 
-	queues of the LCD and I2C LEDs to signify a shutdown.
-	- Parameters: xTimerMotion - Motion Timer
+/*
+	applyState()
+	- Description: Stages the UI zones from a state byte (two bits
+	per zone: off, on, bright dim, low dim). Zones that change fade
+	to their new level. Nothing is written until xZonesFlush().
+	- Parameters: state - state byte
+								duration - fade time in ticks (0 = at once)
 */
-void PIRTimeout( TimerHandle_t xTimerMotion ) {
-	Command cmdTimeout, cmd;
-	portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
-	
-	xTimerReset(xTimerMotion, 0);
-	xTimerStop(xTimerMotion, 0);
-	
-	cmdTimeout.action = 3;
-	cmd.action = 0;
-	cmd.value = 0;
-	cmd.identifier = 6;
-	
-	xQueueSendToBack(xCmdQ, &cmd, 0);
-	xQueueSendToBack(xToLCDQ, &cmdTimeout, 0);
+static void applyState(unsigned char state, portTickType duration) {
+	unsigned int zone;
+	unsigned char level;
+
+	for (zone = 0; zone < NUM_ZONES; zone++) {
+		switch ((state >> (zone * 2)) & 3) {
+			case ZONE_ON:
+				level = fadeLEVEL_FULL;
+				break;
+			case ZONE_PWM0:
+				level = PWM0;
+				break;
+			case ZONE_PWM1:
+				level = PWM1;
+				break;
+			default:
+				level = fadeLEVEL_OFF;
+				break;
+		}
+		vFadeZone(zone, level, duration);
+	}
+}
 
-	// Semphore blocks for TS event otherwise
-	xSemaphoreGiveFromISR(xSensorSemphr, &xHigherPriorityTaskWoken);
+/*
+	vacancyExpired()
+	- Description: Called from the timer service task when a zone
+	has not been used for its timeout (stage occupancyDIMMED) or has
+	stayed dimmed for the grace period (occupancyIDLE). Hands the
+	change to the sensors task without waiting.
+	- Parameters: zone - zone vacated
+								stage - stage reached
+*/
+static void vacancyExpired( unsigned portBASE_TYPE zone, unsigned char stage ) {
+	xCoalescePost(cmdPACK(cmdZONE_VACATED, zone, stage, 0));
+}
+
+/*
+	followOccupancy()
+	- Description: Tracks occupancy after a change: zones that are
+	off stop being tracked, and the zones just changed (or all, for
+	a change to every zone) restart their vacancy timeout
+	- Parameters: state - new state
+								id - zone changed, NUM_ZONES or more for all
+*/
+static void followOccupancy( unsigned char state, int id ) {
+	int zone;
+
+	for (zone = 0; zone < NUM_ZONES; zone++) {
+		if (((state >> (zone * 2)) & 3) == ZONE_OFF) {
+			vOccupancyClear(zone);
+		} else if ((id == zone) || (id >= NUM_ZONES)) {
+			vOccupancyTouch(zone);
+		}
+	}
 }
 
 /*
 	forceState()
-	- Description: Forces the state onto the sensors and pushes
-	command on queue to LCD to reflect the changes on the UI.
+	- Description: Forces the state onto the sensors and publishes
+	it so the LCD reflects the changes on the UI.
 	Function made for simplicity of fire alarm implmentation.
 	Also used for force shutdown stages and clap feature. 
 	Also able to retain the state as callbacks from timers
@@ -101,105 +129,44 @@ void PIRTimeout( TimerHandle_t xTimerMotion ) {
 								fire - boolean to indicate whether fire alarm
 */
 unsigned char forceState(unsigned char state, int fire) {
-	Command forceCMD;
-	portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
-	
-	I20CONCLR = I2C_AA | I2C_SI | I2C_STA | I2C_STO;
-	I20CONSET = I2C_STA;
-	
-	while (!(I20CONSET & I2C_SI));
-	
-	I20DAT = 0xC0;
-	I20CONCLR = I2C_SI | I2C_STA;
-	
-	while (!(I20CONSET & I2C_SI));
-	
-	I20DAT = 0x08;
-	I20CONCLR = I2C_SI;
-	
-	while(!(I20CONSET & I2C_SI));
-	
-	I20DAT    =  state;
-	I20CONCLR =  I2C_SI | I2C_STA;
-
-	while (!(I20CONSET & I2C_SI));
+	applyState(state, 0);
+	xZonesFlush();
 
 	if (fire == 0) {
-		forceCMD.action = 4;
-		forceCMD.state = state;
-		xQueueSendToBack(xToLCDQ, &forceCMD, 0);
-		xSemaphoreGiveFromISR(xSensorSemphr, &xHigherPriorityTaskWoken);
+		vBusPublish(busZONE_STATE, cmdPACK(cmdLCD_REFLECT, 0, 0, state));
 	}
 	TIMEOUT_STATE_CALLBACK = state;
 	return state;
 }
 
 /*
-	StartMotion()
-	- Description: Callback for xTimerStartMotion, checks
-	whether a button has been held or not. Needs to be held for
-	at least default time (1s).
-	- Parameters: xTimerStartMotion - Timer to check whether
-	buttons are held or not
+	fireFrame()
+	- Description: Called from the strobe interrupt each time the
+	fire alarm LEDs alternate; shows the same state on the UI
+	- Parameters: uxFrame - frame sent (0 = STATE_FIRE1)
+								pxHigherPriorityTaskWoken - from the ISR
 */
-void StartMotion (TimerHandle_t xTimerStartMotion) {
-	if (HELD != -1) {
-		TIMEOUT_STATE_CALLBACK = forceState(SHUTDOWN_STATE, 0); // HELD
-	}
-	HELD = 1;
-	PRESSED = 0;
-}
-
-/*
-	FireTimeout()
-	- Description: Timeout evoked when fire alarm alternating
-	state expires. Expires on default time (1s). Also forces
-	alternating state to be reflected on UI. Resets timer
-	on itself until fire alarm is turned off.
-	- Parameters: xTimerFire - Timer for alternating state
-	of fire alarm.
-*/
-void FireTimeout ( TimerHandle_t xTimerFire ) {
+static void fireFrame( unsigned portBASE_TYPE uxFrame, portBASE_TYPE *pxHigherPriorityTaskWoken ) {
 	Command fireCMD;
-	portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
-	fireCMD.action = (FIRE_STATE == 0)?5:6;
-	xQueueSendToBack(xToLCDQ, &fireCMD, 0);
-	xSemaphoreGiveFromISR(xSensorSemphr, &xHigherPriorityTaskWoken);
-
-	forceState(FIRE_STATE?STATE_FIRE1:STATE_FIRE2, 1);
-	FIRE_STATE = (FIRE_STATE == 0)?1:0;
-	xTimerReset(xTimerFire, 0);
+
+	fireCMD = cmdPACK((uxFrame == 0) ? cmdLCD_FIRE_PHASE2 : cmdLCD_FIRE_PHASE1, 0, 0, 0);
+	vBusPublishFromISR(busALARM, fireCMD, pxHigherPriorityTaskWoken);
 }
 
 /*
 	vStartSensors()
-	- Description: Configurations settings for file. Queues
-	are passed into here from main.c
+	- Description: Configurations settings for file. The queue
+	is passed into here from main.c; changes are published on the
+	event bus.
 	- Parameters: uxPriority - Priorty status
 								xQueue - Queue for sensors.c
-								xLCDQueue - Queue for LCD.c
-								xSemphr - Sempahore for LCD
 */
-void vStartSensors ( unsigned portBASE_TYPE uxPriority, xQueueHandle xFromUIQ, xQueueHandle xToLCDQueue, xSemaphoreHandle xSemphr){
+void vStartSensors ( unsigned portBASE_TYPE uxPriority, xQueueHandle xFromUIQ){
 	xCmdQ = xFromUIQ;
-	xSensorSemphr = xSemphr;
-	xToLCDQ = xToLCDQueue;
-
-	/* Enable and configure I2C0 */
-	PCONP    |=  (1 << 7);                /* Enable power for I2C0              */
-
-	/* Initialize pins for SDA (P0.27) and SCL (P0.28) functions                */
-	PINSEL1  &= ~0x03C00000;
-	PINSEL1  |=  0x01400000;
+	vCoalesceInit(xCmdQ);
 
-	/* Clear I2C state machine                                                  */
-	I20CONCLR =  I2C_AA | I2C_SI | I2C_STA | I2C_I2EN;
-	
-	/* Setup I2C clock speed                                                    */
-	I20SCLL   =  0x80;
-	I20SCLH   =  0x80;
-	
-	I20CONSET =  I2C_I2EN;
+	vPCA9532Init();
+	vStrobeInit();
 
 	/* Spawn the console task . */
 	xTaskCreate( vSensorsTask, "Sensors", sensorsSTACK_SIZE, &xCmdQ, uxPriority, ( xTaskHandle * ) NULL );
@@ -208,70 +175,45 @@ void vStartSensors ( unsigned portBASE_TYPE uxPriority, xQueueHandle xFromUIQ, x
 }
 
 /*
-	getButtons()
-	- Description: Gets the state of I2C buttons
-	- Parameters: N/A
+	vSensorsSetPollRates()
+	- Description: Changes the adaptive button polling. The buttons
+	are polled every fast ms for window ms after the last button
+	change or UI command, and every idle ms otherwise.
+	- Parameters: fast - active polling period (ms)
+								idle - idle polling period (ms)
+								window - how long activity keeps the fast rate (ms)
 */
-unsigned char getButtons( ) {
-	unsigned char ledData;
-
-	/* Initialise */
-	I20CONCLR =  I2C_AA | I2C_SI | I2C_STA | I2C_STO;
-	
-	/* Request send START */
-	I20CONSET =  I2C_STA;
-
-	/* Wait for START to be sent */
-	while (!(I20CONSET & I2C_SI));
-
-	/* Request send PCA9532 ADDRESS and R/W bit and clear SI */		
-	I20DAT    =  0xC0;
-	I20CONCLR =  I2C_SI | I2C_STA;
-
-	/* Wait for ADDRESS and R/W to be sent */
-	while (!(I20CONSET & I2C_SI));
-
-	/* Send control word to read PCA9532 INPUT0 register */
-	I20DAT = 0x00;
-	I20CONCLR =  I2C_SI;
-
-	/* Wait for DATA with control word to be sent */
-	while (!(I20CONSET & I2C_SI));
-
-	/* Request send repeated START */
-	I20CONSET =  I2C_STA;
-	I20CONCLR =  I2C_SI;
-
-	/* Wait for START to be sent */
-	while (!(I20CONSET & I2C_SI));
-
-	/* Request send PCA9532 ADDRESS and R/W bit and clear SI */		
-	I20DAT    =  0xC1;
-	I20CONCLR =  I2C_SI | I2C_STA;
-
-	/* Wait for ADDRESS and R/W to be sent */
-	while (!(I20CONSET & I2C_SI));
-
-	I20CONCLR = I2C_SI;
-
-	/* Wait for DATA to be received */
-	while (!(I20CONSET & I2C_SI));
-
-	ledData = I20DAT;
-
-	/* Request send NAQ and STOP */
-	I20CONSET =  I2C_STO;
-	I20CONCLR =  I2C_SI | I2C_AA;
-
-	/* Wait for STOP to be sent */
-	while (I20CONSET & I2C_STO);
+void vSensorsSetPollRates( portTickType fast, portTickType idle, portTickType window ) {
+	xPollFast = fast / portTICK_RATE_MS;
+	xPollIdle = idle / portTICK_RATE_MS;
+	xActiveWindow = window / portTICK_RATE_MS;
+}
 
-	return ledData ^ 0xf;
+/*
+	getButtons()
+	- Description: Polls the inputs of every expander and debounces
+	them all in one update. The same read fetches the LED
+	selectors, which the driver checks against what it last wrote.
+	- Parameters: pxEdges - receives the debounced edges
+	- Returns: debounced state of the UI buttons
+*/
+unsigned char getButtons( DebounceEdges *pxEdges ) {
+	unsigned char inputs[2];
+	unsigned portBASE_TYPE dev;
+
+	for (dev = 0; dev < PCA9532_NUM_DEVICES; dev++) {
+		if (xPCA9532Poll(dev, inputs) == pdPASS) {
+			/* Inputs read low while active */
+			vDebounceSample(dev, (unsigned short) ~((inputs[1] << 8) | inputs[0]));
+		}
+	}
+	xDebounceUpdate(pxEdges);
+	return pxEdges->usState[0] & sensorsBUTTON_MASK;
 }
 
 /*
 	ledBinaryChange()
-	- Description: Changes the I2C LEDs ON/OFF
+	- Description: Changes the I2C LEDs ON/OFF; the caller flushes
 	- Parameters: value - ON/OFF (0/1)
 								id - ID of I2D LED
 								state - Previous state
@@ -293,41 +235,16 @@ unsigned char ledBinaryChange (int value, int id, int state) {
 			break;
 	}
 	
-	I20CONCLR = I2C_AA | I2C_SI | I2C_STA | I2C_STO;
-	I20CONSET = I2C_STA;
-	
-	while (!(I20CONSET & I2C_SI));
-	
-	I20DAT = 0xC0;
-	I20CONCLR = I2C_SI | I2C_STA;
-	
-	while (!(I20CONSET & I2C_SI));
-	
-	I20DAT = 0x08;
-	I20CONCLR = I2C_SI;
+	applyState(state, sensorsFADE_MS / portTICK_RATE_MS);
+	followOccupancy(state, id);
 	
-	while(!(I20CONSET & I2C_SI));
-	
-	I20DAT    =  state;
-	I20CONCLR =  I2C_SI | I2C_STA;
-
-	while (!(I20CONSET & I2C_SI));
-	
-	if (state == 0x00) {
-		xTimerReset(xTimerMotion, 0);
-		xTimerStop(xTimerMotion, 0);
-	} else {
-		xTimerStart(xTimerMotion, 0);
-	}
-	
-	CLAP_STATE = state;
 	return state;
 }
 
 /*
 	ledDim()
 	- Description: Turns I2C LED to one of two dim
-	states.
+	states; the caller flushes.
 	- Parameters: value - PWM0 / PWM1 (2/4)
 							  id - ID of I2C LED
 								state - Previous state
@@ -349,161 +266,187 @@ unsigned char ledDim (int value, int id, int state) {
 			break;
 	}
 	
-	I20CONCLR = I2C_AA | I2C_SI | I2C_STA | I2C_STO;
-	I20CONSET = I2C_STA;
-	
-	while (!(I20CONSET & I2C_SI));
-	
-	// Selects the address of I2C device; write implied
-	I20DAT = 0xC0;
-	I20CONCLR = I2C_SI | I2C_STA;
-	
-	while (!(I20CONSET & I2C_SI));
-	
-	// Selects the LED register
-	I20DAT = 0x08;
-	I20CONCLR = I2C_SI;
-	
-	while(!(I20CONSET & I2C_SI));
-	
 	// Set LED registers to whatever
-	I20DAT = state;
-	I20CONCLR = I2C_SI | I2C_STA;
-	
-	while (!(I20CONSET & I2C_SI));
-	
-	xTimerStart(xTimerMotion, 0);
+	applyState(state, sensorsFADE_MS / portTICK_RATE_MS);
+	followOccupancy(state, id);
 	
 	return state;
 }
 
 /*
 	setDefaultPWM()
-	- Description: Sets variables PWM0 and PWM1 variables to
-	corresponding registers.
+	- Description: Sets both prescalers of every expander and starts
+	its PWM0/PWM1 banks at the two dim levels, one auto-increment
+	transaction per expander. The fade engine moves the banks from
+	there.
 	- Parameters: N/A
 */
 void setDefaultPWM (void) {
-	/* Initialise */
-	I20CONCLR = I2C_AA | I2C_SI | I2C_STA | I2C_STO;
-	
-	/* Request send START */
-	I20CONSET = I2C_STA;
-	
-	/* Wait for START to be sent */
-	while (!(I20CONSET & I2C_SI));
-	
-	// Selects the address of I2C device; write implied
-	I20DAT = 0xC0;
-	I20CONCLR = I2C_SI | I2C_STA;
-	
-	while (!(I20CONSET & I2C_SI));
-	
-	// Selects the PWM0 register
-	I20DAT = 0x03;
-	I20CONCLR = I2C_SI;
-	
-	while(!(I20CONSET & I2C_SI));
-	
-	I20DAT    =  PWM0;
-	I20CONCLR =  I2C_SI | I2C_STA;
+	vFadeInit(PSC, PWM0, PWM1);
+}
 
-	while (!(I20CONSET & I2C_SI));
-	
-	/* Request send repeated START */
-	I20CONSET =  I2C_STA;
-	I20CONCLR =  I2C_SI;
+/*
+	fireAlarmInteraction()
+	- Description: Fire alarm actuator
+	- Parameters: fire - to turn FIRE alarm ON/OFF
+	- Returns: the new state
+*/
+unsigned char fireAlarmInteraction (int fire) {
+	unsigned char state;
+	unsigned char modes[strobeNUM_FRAMES][NUM_ZONES];
+	unsigned int zone;
+	ON_FIRE = fire;
+	if (fire == 1) {
+		state = forceState(STATE_FIRE1, 1);
+		vBusPublish(busALARM, cmdPACK(cmdLCD_SHUTDOWN, 0, 0, 0));
+		followOccupancy(0x00, NUM_ZONES); // no vacancy switching during an alarm
+		// TIMER1 alternates the two states from here on
+		for (zone = 0; zone < NUM_ZONES; zone++) {
+			modes[0][zone] = (STATE_FIRE1 >> (zone * 2)) & 3;
+			modes[1][zone] = (STATE_FIRE2 >> (zone * 2)) & 3;
+		}
+		vStrobeStart(modes, fireFrame);
+	} else {
+		vStrobeStop();
+		vBusPublish(busALARM, cmdPACK(cmdLCD_FIRE_OFF, 0, 0, 0));
+		state = forceState(0x00, 0);
+	}
+	return state;
+}
 
-	/* Wait for START to be sent */
-	while (!(I20CONSET & I2C_SI));
-	
-	// Selects the PWM1 register
-	I20DAT = 0x05;
-	I20CONCLR = I2C_SI;
-	
-	while(!(I20CONSET & I2C_SI));
-	
-	I20DAT    =  PWM1;
-	I20CONCLR =  I2C_SI | I2C_STA;
+/*
+	processGesture()
+	- Description: Acts on a button gesture. A double press toggles
+	the zone of that button, holding a button while everything is
+	off brings back the last state and the key codes switch the
+	fire alarm.
+	- Parameters: pxGesture - gesture recognised
+								state - current state
+	- Returns: the new state
+*/
+static unsigned char processGesture(const GestureEvent *pxGesture, unsigned char state) {
+	int id = pxGesture->ucButton;
+
+	switch (pxGesture->ucType) {
+		case gestureDOUBLE:
+			if (ON_FIRE == 0) {
+				// Switch the zone, then show the new state on the LCD
+				state = ledBinaryChange((((state >> (id * 2)) & 3) == 0) ? 1 : 0, id, state);
+				vBusPublish(busZONE_STATE, cmdPACK(cmdLCD_REFLECT, id, 0, state));
+			}
+			break;
+		case gestureHOLD:
+			if ((state == 0x00) && (ON_FIRE == 0)) {
+				state = forceState(SHUTDOWN_STATE, 0);
+				followOccupancy(state, NUM_ZONES);
+			}
+			break;
+		case gestureSEQUENCE:
+			// Key codes are listed in tools/keycodes.txt
+			if ((id == keyCODE_FIRE_ON) && (ON_FIRE == 0)) {
+				state = fireAlarmInteraction(1);
+			} else if ((id == keyCODE_FIRE_OFF) && (ON_FIRE == 1)) {
+				state = fireAlarmInteraction(0);
+			}
+			break;
+		default:
+			break;
+	}
+	return state;
+}
+
+/*
+	vacateZone()
+	- Description: Dims a vacated zone to the low level, or switches
+	it off at the end of the grace period, and publishes the
+	result. Ignored if the zone has been used since the timer
+	expired, and during a fire alarm.
+	- Parameters: id - zone
+								stage - occupancyDIMMED / occupancyIDLE
+								state - current state
+	- Returns: the new state
+*/
+static unsigned char vacateZone(int id, int stage, unsigned char state) {
+	unsigned char previous = state;
+
+	if ((ON_FIRE != 0) || (ucOccupancyStage(id) != stage) || (((state >> (id * 2)) & 3) == ZONE_OFF)) {
+		return state;
+	}
+	state &= ~(3 << id * 2);
+	if (stage == occupancyDIMMED) {
+		state |= ZONE_PWM1 << id * 2;
+	} else if (state == 0x00) {
+		SHUTDOWN_STATE = previous; // a long press brings the room back
+	}
+	applyState(state, sensorsFADE_MS / portTICK_RATE_MS);
 
-	while (!(I20CONSET & I2C_SI));
+	vBusPublish(busZONE_STATE, cmdPACK(cmdLCD_REFLECT, id, 0, state));
+	return state;
 }
 
 /*
-	ClapTimeout()
-	- Description: When double click is detected on I2C
-	buttons, turns the corresponding light the I2C LED
-	is on to ON, OFF otherwise
-	- Parameters: xTimerClapClap - Clap clap timer
+	processCommand()
+	- Description: Applies one command from the UI. LED changes are
+	staged only, so a burst of commands costs one flush.
+	- Parameters: cmd - command received
+								state - current state
+	- Returns: the new state
 */
-void ClapTimeout (TimerHandle_t xTimerClapClap) {
-	Command cmdUI, cmd;
-	int switchState;
-	portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
-	
-	xTimerReset(xTimerClapClap, 0);
-	xTimerStop(xTimerClapClap, 0);
-	
-	if ((clapClap == 4) && (ON_FIRE == 0)) {
-		// Get state of individual LED from LCD
-		cmdUI.action = 8;
-		cmdUI.identifier = BUTTON_PRESSED;
-		xQueueSendToBack(xToLCDQ, &cmdUI, 0);
-		xSemaphoreGiveFromISR(xSensorSemphr, &xHigherPriorityTaskWoken);
-		xQueueReceive(xCmdQ, &cmdUI, portMAX_DELAY);
-		switchState = cmdUI.value;
-		switchState = (switchState == 0)?1:0; // Switch state
-		
-		// Send event to LCD Queue
-		cmdUI.action = 4;
-		cmdUI.identifier = BUTTON_PRESSED;
-		cmdUI.state = CLAP_STATE;
-		cmdUI.state &= ~(3 << BUTTON_PRESSED * 2);
-		if (switchState == 1)
-			cmdUI.state |= 1 << BUTTON_PRESSED * 2;
-		else
-			cmdUI.state &=  ~(3  << BUTTON_PRESSED * 2);
-		xQueueSendToBack(xToLCDQ, &cmdUI, 0);
-	  xSemaphoreGiveFromISR(xSensorSemphr, &xHigherPriorityTaskWoken);
-		
-		// Send event to Sensors Queue
-		cmd.action = 0;
-		cmd.value = switchState;
-		cmd.identifier = BUTTON_PRESSED;
-		xQueueSendToBack(xCmdQ, &cmd, 0);
+static unsigned char processCommand(Command cmd, unsigned char state) {
+	switch (cmdACTION(cmd)) {
+		case cmdSWITCH:
+			state = ledBinaryChange(cmdVALUE(cmd), cmdIDENTIFIER(cmd), state);
+			break;
+		case cmdDIM:
+			state = ledDim(cmdVALUE(cmd), cmdIDENTIFIER(cmd), state);
+			break;
+		case cmdPRESET_SAVE:
+			if (cmdVALUE(cmd) == 0) {
+				STATE_P1 = state;
+			}
+			else {
+				STATE_P2 = state;
+			}
+			break;
+		case cmdPRESET_RECALL:
+			if (ON_FIRE == 0) {
+				state = forceState((cmdVALUE(cmd) == 0)?STATE_P1:STATE_P2, 0);
+				followOccupancy(state, NUM_ZONES);
+			}
+			break;
+		case cmdZONE_VACATED:
+			state = vacateZone(cmdIDENTIFIER(cmd), cmdVALUE(cmd), state);
+			break;
+		default:
+			break;
 	}
-	TIMEOUT_STATE_CALLBACK = CLAP_STATE;
-	clapClap = 0;
-	clapID = 0;
+	return state;
 }
 
 /*
-	fireAlarmInteraction()
-	- Description: Fire alarm actuator
-	- Parameters: fire - to turn FIRE alarm ON/OFF
+	processCommands()
+	- Description: Applies every command waiting on the queue, then
+	the zone targets coalesced since, newest last
+	- Parameters: xQueue - sensors queue
+								state - current state
+	- Returns: the new state
 */
-unsigned char fireAlarmInteraction (int fire) {
-	unsigned char state;
+static unsigned char processCommands(xQueueHandle xQueue, unsigned char state) {
 	Command cmd;
-	portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
-	ON_FIRE = fire;
-	if (fire == 1) {
-		TIMEOUT_STATE_CALLBACK = forceState(FIRE_STATE?STATE_FIRE1:STATE_FIRE2, 1);
-		FIRE_STATE = (FIRE_STATE == 0)?1:0;
-		xTimerStart(xTimerFire, 0);
-		cmd.action = 3;
-		xQueueSendToBack(xToLCDQ, &cmd, 0);
-		xSemaphoreGiveFromISR(xSensorSemphr, &xHigherPriorityTaskWoken);
-		xTimerReset(xTimerMotion, 0);
-		xTimerStop(xTimerMotion, 0);
-	} else if (fire == 0) {
-		cmd.action = 7;
-		xQueueReset(xToLCDQ); // Fixes unresponsive UI bug
-		xQueueSendToBack(xToLCDQ, &cmd, 0);
-		xSemaphoreGiveFromISR(xSensorSemphr, &xHigherPriorityTaskWoken);
-		xTimerReset(xTimerFire, 0);
-		xTimerStop(xTimerFire, 0);
-		TIMEOUT_STATE_CALLBACK = forceState(0x00, 0);
+	Command targets[NUM_ZONES];
+	unsigned char dirty;
+	unsigned int zone;
+
+	do {
+		while (xQueueReceive(xQueue, &cmd, 0) == pdTRUE) {
+			state = processCommand(cmd, state);
+		}
+	} while (xCoalesceTake(targets, &dirty) == pdFAIL);
+
+	for (zone = 0; zone < NUM_ZONES; zone++) {
+		if (dirty & (1 << zone)) {
+			state = processCommand(targets[zone], state);
+		}
 	}
 	return state;
 }
@@ -515,24 +458,22 @@ unsigned char fireAlarmInteraction (int fire) {
 								pvParameters - Misc parameters
 */
 static portTASK_FUNCTION( vSensorsTask, pvParameters ){
-	portTickType xLastWakeTime;
-	unsigned char buttonState;
-	unsigned char lastButtonState;
+	portTickType xNextPoll;
+	portTickType xLastActivity;
+	portTickType xNow;
+	portTickType xWait;
+	portTickType xFadeWait = portMAX_DELAY;
+	DebounceEdges edges;
 	unsigned char changedState;
 	unsigned int i;
-	unsigned char mask;
+	GestureEvent gestures[gestureMAX_EVENTS];
+	unsigned portBASE_TYPE uxGestures;
 	unsigned char state = 0x00;
 	xQueueHandle xCmdQ;
 	Command cmd;
-	int combination_activate = 0;
-	int combination_deactivate = 0;
-	int alternatingBit = 0;
 	
 	/* Start all the timers */
-	xTimerMotion = xTimerCreate("TimerMotion", 30000, pdFALSE, (void *) 0, PIRTimeout);
-	xTimerFire = xTimerCreate("TimerFire", 1000, pdFALSE, (void *) 0, FireTimeout);
-	xTimerClapClap = xTimerCreate("TimerClap", 500, pdFALSE, (void *) 0, ClapTimeout);
-	xTimerStartMotion = xTimerCreate("TimerStartMotion", 1000, pdFALSE, (void *) 0, StartMotion);
+	vStartOccupancy(vacancyExpired);
 	
 	/* Sensors queue */
 	xCmdQ = * ( ( xQueueHandle * ) pvParameters );
@@ -540,11 +481,13 @@ static portTASK_FUNCTION( vSensorsTask, pvParameters ){
 	/* Just to stop compiler warnings. */
 	( void ) pvParameters;
 
-	/* initialise lastState with all buttons off */
-	lastButtonState = 0;
+	/* start with all buttons off */
+	vDebounceInit();
+	vGestureInit();
 
-	/* initial xLastWakeTime for accurate polling interval */
-	xLastWakeTime = xTaskGetTickCount();
+	/* polls are scheduled from a fixed base for an accurate interval */
+	xNextPoll = xTaskGetTickCount();
+	xLastActivity = xNextPoll;
 	
 	/* Set default values for the PWM's */
 	setDefaultPWM();
@@ -557,101 +500,65 @@ static portTASK_FUNCTION( vSensorsTask, pvParameters ){
 		*/
 		if (TIMEOUT_STATE_CALLBACK != 0xFF) {
 			state = TIMEOUT_STATE_CALLBACK;
-			CLAP_STATE = TIMEOUT_STATE_CALLBACK;
 			TIMEOUT_STATE_CALLBACK = 0xFF;
 		}
-		xQueueReceive(xCmdQ, &cmd, 0);
-		/*
-			0 - LED TURN ON/OFF
-			1 - LED TURN DIM1/DIM2
-			2 - Preset save
-			3 - Alternating fire state
-		*/
-		switch (cmd.action) {
-			case 0: 
-				state = ledBinaryChange(cmd.value, cmd.identifier, state);
-				break;
-			case 1:
-				state = ledDim(cmd.dimValue, cmd.identifier, state);
-				break;
-			case 2:
-				if (cmd.value == 0) {
-					STATE_P1 = state;
-				}
-				else {
-					STATE_P2 = state;
-				}
-				break;
-			case 3:
-				if (ON_FIRE == 0)
-					state = forceState((cmd.value == 0)?STATE_P1:STATE_P2, 0);
-				break;
-			default:
-				break;
+		
+		/* sleep until a command arrives, a fade step or the next poll is due */
+		xNow = xTaskGetTickCount();
+		xWait = ((long) (xNextPoll - xNow) > 0) ? (xNextPoll - xNow) : 0;
+		if (xFadeWait < xWait) {
+			xWait = xFadeWait;
+		}
+		if (xQueueReceive(xCmdQ, &cmd, xWait) == pdTRUE) {
+			xLastActivity = xTaskGetTickCount();
+			/* drain the whole burst before touching the bus */
+			state = processCommand(cmd, state);
+			state = processCommands(xCmdQ, state);
 		}
-		cmd.action = -1;
 		
+		/* step any fades that are due, then one flush for everything */
+		xFadeWait = xFadeService();
+		xZonesFlush();
+		
+		if ((long) (xTaskGetTickCount() - xNextPoll) < 0) {
+			continue;
+		}
+		
+		/* Retry a vacancy timer change the timer queue had no room for */
+		vOccupancyPoll();
+
 		/* Read buttons */
-		buttonState = getButtons();
-		changedState = buttonState ^ lastButtonState;
-		if (buttonState != lastButtonState) {
-		  /* iterate over each of the 4 LS bits looking for changes in state */
-			for (i = 0; i <= 3; i = i + 1) {
-				mask = 1 << i;
-        if (changedState & mask) {
-					PRESSED = (PRESSED == 0) ? 1 : 0;
-					xTimerReset(xTimerMotion, 0); // Resets motion (keeps on)
-					// HELD button status check
-					if ((state == 0x00) && (ON_FIRE == 0)) {
-						xTimerStart( xTimerStartMotion, 0);
-						HELD = (HELD == PRESSED)?PRESSED:-1;
-					}
-					// CLAP button status check
-					if (clapClap == 0) {
-						xTimerStart( xTimerClapClap, 0 );
-						clapID = i;
-						clapClap++;
-						BUTTON_PRESSED = i;
-						CLAP_STATE = state;
-					} else if (i == clapID) {
-						clapClap++;
-					}
-					
-					// Combinational FIRE alarm deployment
-					// PUSH-BUTTON command <variable> KEY_CODES GLOBAL to activate/deactivate
-					if (alternatingBit == 0) {
-						// Check activate codes
-						if (i == FIRE_ACTIVATE_CODE[combination_activate] - 1) {
-							combination_activate++;
-						} else if (i == FIRE_ACTIVATE_CODE[0]) {
-							combination_activate = 1;
-						} else {
-							combination_activate = 0;
-						} if (combination_activate == 4) {
-							if (ON_FIRE == 0)
-								state = fireAlarmInteraction((ON_FIRE==0)?1:ON_FIRE);
-							combination_activate = 0;
-						}
-						// Check deactivate codes
-						if (i == FIRE_DEACTIVATE_CODE[combination_deactivate] - 1) {
-							combination_deactivate++;
-						} else if (i == FIRE_DEACTIVATE_CODE[0]) {
-							combination_deactivate = 1;
-						} else {
-							combination_deactivate = 0;
-						} if (combination_deactivate == 4) {
-							if (ON_FIRE == 1)
-								state = fireAlarmInteraction((ON_FIRE==1)?0:ON_FIRE);
-							combination_deactivate = 0;
-						}
-					}
-					alternatingBit = (alternatingBit == 0)?1:0;
-        }
-		  }
-			/* remember new state */
-			lastButtonState = buttonState;
+		getButtons(&edges);
+		changedState = (edges.usPressed[0] | edges.usReleased[0]) & sensorsBUTTON_MASK;
+		if ((edges.usBouncing[0] & sensorsBUTTON_MASK) != 0) {
+			xLastActivity = edges.xTime; // settle at the fast rate
+		}
+		if (changedState != 0) {
+			xLastActivity = edges.xTime;
+			// Using a button keeps its zone on
+			for (i = 0; i < NUM_ZONES; i++) {
+				if ((changedState & (1 << i)) && (((state >> (i * 2)) & 3) != ZONE_OFF)) {
+					vOccupancyTouch(i);
+				}
+			}
+		}
+		/* clap, hold and fire code detection */
+		uxGestures = uxGestureProcess(&edges, gestures);
+		for (i = 0; i < uxGestures; i++) {
+			state = processGesture(&gestures[i], state);
+		}
+		if (uxGestures != 0) {
+			xZonesFlush();
+		}
+		/* schedule next poll; fast while the buttons are in use */
+		xNow = xTaskGetTickCount();
+		if ((xNow - xLastActivity) < xActiveWindow) {
+			xNextPoll += xPollFast;
+		} else {
+			xNextPoll += xPollIdle;
+		}
+		if ((long) (xNextPoll - xNow) < 0) {
+			xNextPoll = xNow; // fell behind, poll again straight away
 		}
-    /* delay before next poll */
-    vTaskDelayUntil( &xLastWakeTime, 20);
 	}
 }
@@ -1,6 +1,15 @@
 #ifndef SENSORS_H
 #define SENSORS_H
 
-void vStartSensors( unsigned portBASE_TYPE uxPriority, xQueueHandle xQueue, xQueueHandle xLCDQueue, xSemaphoreHandle xLcdSemphr );
+/* Adaptive button polling defaults (ms) */
+#define sensorsPOLL_FAST_MS			5
+#define sensorsPOLL_IDLE_MS			50
+#define sensorsACTIVE_WINDOW_MS		5000
+
+/* Fade time for zones switched or dimmed from the UI (ms) */
+#define sensorsFADE_MS				400
+
+void vStartSensors( unsigned portBASE_TYPE uxPriority, xQueueHandle xQueue );
+void vSensorsSetPollRates( portTickType fast, portTickType idle, portTickType window );
 
 #endif
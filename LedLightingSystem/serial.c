@@ -82,6 +82,7 @@
 
 /* Demo application includes. */
 #include "serial.h"
+#include "ring.h"
 
 /*-----------------------------------------------------------*/
 
@@ -106,6 +107,11 @@
 #define serNO_BLOCK						( ( portTickType ) 0 )
 #define serMAX_BLOCK					( ( portTickType ) 1000 )
 
+/* Received characters; a power of two.  The Rx ring is not sized from
+uxQueueLength as its buffer is static. */
+#define serRX_BUFFER_LENGTH				( ( unsigned portBASE_TYPE ) 256 )
+#define serRX_NOTIFY_BIT				( ( unsigned long ) 0x01 )
+
 /* Constant to access the VIC. */
 #define serCLEAR_VIC_INTERRUPT			( ( unsigned long ) 0 )
 
@@ -131,9 +137,11 @@ void vUART_ISRHandler( void );
 
 /*-----------------------------------------------------------*/
 
-/* Queues used to hold received characters, and characters waiting to be
-transmitted. */
-static xQueueHandle xRxedChars; 
+/* Ring used to hold received characters, and queue of characters waiting
+to be transmitted.  Only the ISR puts to the ring and only the task calling
+xSerialGetChar() takes from it, so it needs no critical sections. */
+static Ring xRxedChars;
+static char cRxBuffer[ serRX_BUFFER_LENGTH ];
 static xQueueHandle xCharsForTx; 
 
 /* Communication flag between the interrupt service routine and serial API. */
@@ -146,15 +154,14 @@ xComPortHandle xSerialPortInitMinimal( unsigned long ulWantedBaud, unsigned port
 	unsigned long ulDivisor, ulWantedClock;
 	xComPortHandle xReturn = serHANDLE;
 
-	/* Create the queues used to hold Rx and Tx characters. */
-	xRxedChars = xQueueCreate( uxQueueLength, ( unsigned portBASE_TYPE ) sizeof( char ) );
+	/* Create the ring and queue used to hold Rx and Tx characters. */
+	vRingInit( &xRxedChars, cRxBuffer, serRX_BUFFER_LENGTH, ( unsigned portBASE_TYPE ) sizeof( char ), serRX_NOTIFY_BIT );
 	xCharsForTx = xQueueCreate( uxQueueLength + 1, ( unsigned portBASE_TYPE ) sizeof( char ) );
 
 	/* Initialise the THRE empty flag. */
 	lTHREEmpty = pdTRUE;
 
 	if( 
-		( xRxedChars != serINVALID_QUEUE ) && 
 		( xCharsForTx != serINVALID_QUEUE ) && 
 		( ulWantedBaud != ( unsigned long ) 0 ) 
 	  )
@@ -206,7 +213,7 @@ signed portBASE_TYPE xSerialGetChar( xComPortHandle pxPort, char *pcRxedChar, po
 
 	/* Get the next character from the buffer.  Return false if no characters
 	are available, or arrive before xBlockTime expires. */
-	if( xQueueReceive( xRxedChars, pcRxedChar, xBlockTime ) )
+	if( xRingGet( &xRxedChars, pcRxedChar, xBlockTime ) == pdPASS )
 	{
 		return pdTRUE;
 	}
@@ -316,9 +323,9 @@ unsigned char ucInterrupt;
 	
 			case serSOURCE_RX_TIMEOUT :
 			case serSOURCE_RX	:	/* A character was received.  Place it in 
-									the queue of received characters. */
+									the ring of received characters. */
 									cChar = U0RBR;
-									xQueueSendFromISR( xRxedChars, &cChar, &xHigherPriorityTaskWoken );
+									xRingPutFromISR( &xRxedChars, &cChar, &xHigherPriorityTaskWoken );
 									break;
 	
 			default				:	/* There is nothing to do, leave the ISR. */
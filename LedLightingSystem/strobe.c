@@ -0,0 +1,267 @@
+/*
+	Fire alarm strobe. The zones alternate between two frames that
+	are worked out once when the alarm starts: the LED selector
+	bytes of every expander with zones, each in its own static I2C
+	transaction. TIMER1 matches once per period, and its interrupt
+	puts the next transaction at the front of the I2C request queue,
+	so the cadence comes from the hardware timer and not from the
+	tick, the timer service task or how busy the bus is. Nothing is
+	allocated or copied in the interrupt.
+
+	An expander whose previous frame is still queued or on the bus
+	(a stuck bus, retries) skips the frame, which is counted, so a
+	descriptor is never rewritten while in use and frames of one
+	expander never overtake each other.
+
+	While the strobe runs the selector registers are detached from
+	the PCA9532 mirror, so staged zone changes wait until it stops.
+	Stopping waits for the frames still pending and hands the mirror
+	the last one that reached the expander.
+
+	Wesley Fung (fungw@tcd.ie)
+*/
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "lpc24xx.h"
+#include <stdio.h>
+#include "i2c.h"
+#include "pca9532.h"
+#include "zones.h"
+#include "strobe.h"
+#include "evlog.h"
+#include "hrtime.h"
+
+/* Selector registers LS0..LS3 make up a frame */
+#define strobeFRAME_LENGTH		4
+
+/* TIMER1 setup */
+#define strobePCONP_TIMER1		( ( unsigned long ) ( 1 << 2 ) )
+#define strobeTIMER_ENABLE		0x01
+#define strobeTIMER_RESET		0x02
+#define strobeMR0_INTERRUPT		0x01
+#define strobeMR0_RESET			0x02
+#define strobeMATCH_COUNT		( ( configPERIPHERAL_CLOCK_HZ / 1000UL ) * strobePERIOD_MS )
+
+/* Constants to setup the VIC for TIMER1; ahead of I2C0 and UART0 */
+#define strobeVIC_CHANNEL_BIT	( ( unsigned long ) ( 1 << 5 ) )
+#define strobeVIC_PRIORITY		( ( unsigned long ) 4 )
+
+/* Interrupt handlers */
+extern void vStrobe_ISREntry( void );
+void vStrobe_ISRHandler( void );
+
+/* Frames, one transaction per expander, and the bytes they send */
+static I2CTransfer xFrames[strobeNUM_FRAMES][PCA9532_NUM_DEVICES];
+static unsigned char ucFrameData[strobeNUM_FRAMES][PCA9532_NUM_DEVICES][1 + strobeFRAME_LENGTH];
+/* Expanders with zones; only those are strobed */
+static unsigned char ucStrobed[PCA9532_NUM_DEVICES];
+
+/* Frame last sent, and who is told about it */
+static volatile unsigned portBASE_TYPE uxFrame;
+/* Frame last queued for each expander, or strobeNUM_FRAMES if none */
+static volatile unsigned char ucQueued[PCA9532_NUM_DEVICES];
+static StrobeHandler pxFrameHandler;
+static portBASE_TYPE xRunning;
+
+/* Statistics, from the interrupt */
+static volatile unsigned long ulFramesSent;
+static volatile unsigned long ulFramesDropped;
+static volatile unsigned long ulFramesSkipped;
+static volatile unsigned long ulLastTime;
+static volatile unsigned long ulIntervalMin;
+static volatile unsigned long ulIntervalMax;
+
+/*
+	prvPending()
+	- Description: Whether a frame of an expander is still queued or
+	on the bus
+	- Parameters: dev - device index
+*/
+static portBASE_TYPE prvPending( unsigned portBASE_TYPE dev ) {
+	unsigned portBASE_TYPE frame;
+
+	for (frame = 0; frame < strobeNUM_FRAMES; frame++) {
+		if (xFrames[frame][dev].xPending != pdFALSE) {
+			return pdTRUE;
+		}
+	}
+	return pdFALSE;
+}
+
+/*
+	vStrobeInit()
+	- Description: Powers up TIMER1 (stopped) and installs its
+	interrupt handler. Must be called before the scheduler starts.
+	- Parameters: N/A
+*/
+void vStrobeInit( void ) {
+	PCONP |= strobePCONP_TIMER1;
+
+	T1TCR = strobeTIMER_RESET;
+	T1CTCR = 0x0;				/* Timer mode */
+	T1PR = 0x0;					/* Prescale = 1 */
+	T1MR0 = strobeMATCH_COUNT - 1;
+	T1MCR = strobeMR0_INTERRUPT | strobeMR0_RESET;
+	T1IR = strobeMR0_INTERRUPT;
+
+	/* Setup VIC for TIMER1 interrupts */
+	VICIntSelect &= ~strobeVIC_CHANNEL_BIT;	/* Configure vector 5 (TIMER1) for IRQ */
+	VICVectPriority5 = strobeVIC_PRIORITY;
+	VICVectAddr5 = (unsigned long)vStrobe_ISREntry;
+	VICIntEnable = strobeVIC_CHANNEL_BIT;
+}
+
+/*
+	vStrobeStart()
+	- Description: Builds the frames and starts alternating them,
+	the first straight away. Restarts the strobe if it is running.
+	Must be called from a task.
+	- Parameters: pucModes - mode of each zone in each frame;
+								pins that are not zones keep their staged mode
+								pxHandler - told of each frame sent; may be NULL
+*/
+void vStrobeStart( const unsigned char pucModes[strobeNUM_FRAMES][NUM_ZONES], StrobeHandler pxHandler ) {
+	unsigned char selectors[strobeFRAME_LENGTH];
+	unsigned portBASE_TYPE dev;
+	unsigned portBASE_TYPE frame;
+	unsigned portBASE_TYPE zone;
+
+	vStrobeStop();
+
+	for (dev = 0; dev < PCA9532_NUM_DEVICES; dev++) {
+		ucStrobed[dev] = 0;
+	}
+	for (zone = 0; zone < NUM_ZONES; zone++) {
+		ucStrobed[uxZoneDevice(zone)] = 1;
+	}
+	for (frame = 0; frame < strobeNUM_FRAMES; frame++) {
+		for (dev = 0; dev < PCA9532_NUM_DEVICES; dev++) {
+			if (ucStrobed[dev]) {
+				vZonesCompose(dev, pucModes[frame], selectors);
+				vPCA9532Describe(dev, PCA9532_LS0, selectors, strobeFRAME_LENGTH, &xFrames[frame][dev], ucFrameData[frame][dev]);
+			}
+		}
+	}
+	for (dev = 0; dev < PCA9532_NUM_DEVICES; dev++) {
+		ucQueued[dev] = strobeNUM_FRAMES;
+		if (ucStrobed[dev]) {
+			vPCA9532Detach(dev, PCA9532_LS0);
+		}
+	}
+
+	pxFrameHandler = pxHandler;
+	uxFrame = strobeNUM_FRAMES - 1;
+	ulIntervalMin = 0xFFFFFFFF;
+	ulIntervalMax = 0;
+	ulLastTime = 0;
+	xRunning = pdTRUE;
+
+	/* Out of reset, one count short of the match, so frame 0 goes
+	out at once */
+	T1TCR = 0;
+	T1TC = strobeMATCH_COUNT - 2;
+	T1TCR = strobeTIMER_ENABLE;
+}
+
+/*
+	vStrobeStop()
+	- Description: Stops the strobe, waits for the frames still
+	pending and gives the selector registers back to the PCA9532
+	mirror, with the last frame that reached each expander. If that
+	is not known the mirror rewrites them at the next flush.
+	Must be called from a task.
+	- Parameters: N/A
+*/
+void vStrobeStop( void ) {
+	unsigned portBASE_TYPE dev;
+	unsigned portBASE_TYPE frame;
+
+	T1TCR = strobeTIMER_RESET;
+	T1IR = strobeMR0_INTERRUPT;
+	if (xRunning == pdFALSE) {
+		return;
+	}
+	xRunning = pdFALSE;
+
+	for (dev = 0; dev < PCA9532_NUM_DEVICES; dev++) {
+		if (ucStrobed[dev] == 0) {
+			continue;
+		}
+		/* The bus manager gives up on a stuck bus, so this ends */
+		while (prvPending(dev)) {
+			vTaskDelay(1);
+		}
+		frame = ucQueued[dev];
+		if ((frame < strobeNUM_FRAMES) && (xFrames[frame][dev].xResult == i2cOK)) {
+			vPCA9532Attach(dev, &ucFrameData[frame][dev][1]);
+		} else {
+			vPCA9532Attach(dev, NULL);
+		}
+	}
+}
+
+/*
+	vStrobePrintStats()
+	- Description: Prints the frames sent and dropped and the
+	shortest and longest time between two frames on the console
+	- Parameters: N/A
+*/
+void vStrobePrintStats( void ) {
+	printf("Strobe: %lu frames, %lu dropped, %lu skipped (previous frame pending)\r\n", ulFramesSent, ulFramesDropped, ulFramesSkipped);
+	if (ulIntervalMax > 0) {
+		printf("Strobe interval us: min %lu, max %lu\r\n", ulIntervalMin / hrtimeCOUNTS_PER_US, ulIntervalMax / hrtimeCOUNTS_PER_US);
+	}
+}
+
+/*
+	vStrobe_ISRHandler()
+	- Description: TIMER1 match. Queues the next frame of every
+	strobed expander ahead of all other bus requests.
+	- Parameters: N/A
+*/
+void vStrobe_ISRHandler( void ) {
+	portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+	unsigned portBASE_TYPE dev;
+	unsigned long ulNow;
+	unsigned long ulInterval;
+
+	T1IR = strobeMR0_INTERRUPT;
+
+	ulNow = ulHRTimeGetFromISR();
+	if (ulLastTime != 0) {
+		ulInterval = ulNow - ulLastTime;
+		if (ulInterval < ulIntervalMin) {
+			ulIntervalMin = ulInterval;
+		}
+		if (ulInterval > ulIntervalMax) {
+			ulIntervalMax = ulInterval;
+		}
+	}
+	ulLastTime = ulNow;
+
+	uxFrame = (uxFrame + 1) % strobeNUM_FRAMES;
+	for (dev = 0; dev < PCA9532_NUM_DEVICES; dev++) {
+		if (ucStrobed[dev] == 0) {
+			continue;
+		}
+		if (prvPending(dev)) {
+			ulFramesSkipped++;
+		} else if (xI2CTransferFromISR(&xFrames[uxFrame][dev], &xHigherPriorityTaskWoken) == pdPASS) {
+			ucQueued[dev] = (unsigned char) uxFrame;
+			vEvLogRecordFromISR(evlogI2C_WRITE, ((unsigned long) dev << 16) | ((unsigned long) PCA9532_LS0 << 8) | strobeFRAME_LENGTH);
+			ulFramesSent++;
+		} else {
+			ulFramesDropped++;
+		}
+	}
+	if (pxFrameHandler != NULL) {
+		pxFrameHandler(uxFrame, &xHigherPriorityTaskWoken);
+	}
+
+	VICVectAddr = 0;			/* Clear VIC interrupt */
+
+	/* Exit the ISR.  If the bus manager task was woken then a context
+	switch will occur. */
+	portEXIT_SWITCHING_ISR( xHigherPriorityTaskWoken );
+}
@@ -0,0 +1,21 @@
+#ifndef STROBE_H
+#define STROBE_H
+
+#include "FreeRTOS.h"
+#include "zones.h"
+
+/* Time each of the two strobe frames is shown (ms) */
+#define strobePERIOD_MS			1000
+
+/* Alternating frames */
+#define strobeNUM_FRAMES		2
+
+/* Called from the TIMER1 interrupt each time a frame is sent */
+typedef void (*StrobeHandler)( unsigned portBASE_TYPE uxFrame, portBASE_TYPE *pxHigherPriorityTaskWoken );
+
+void vStrobeInit( void );
+void vStrobeStart( const unsigned char pucModes[strobeNUM_FRAMES][NUM_ZONES], StrobeHandler pxHandler );
+void vStrobeStop( void );
+void vStrobePrintStats( void );
+
+#endif
@@ -0,0 +1,119 @@
+/*
+	Timer callback timing. The kernel calls vTimerStatsEnter() and
+	vTimerStatsExit() around every software timer callback (see the
+	traceTIMER_CALLBACK_... hooks in FreeRTOSConfig.h), and the
+	longest callback is kept with the name of its timer. Callbacks
+	all run in the timer service task, one at a time, so a single
+	start time is enough. A long callback delays every other timer,
+	so this figure is their worst-case extra latency.
+
+	The "tbatch" console command checks xTimerBatchCommand(): one
+	batch starts a short timer and starts and stops a long one, and
+	only the short one must fire.
+
+	Wesley Fung (fungw@tcd.ie)
+*/
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+#include <stdio.h>
+#include "hrtime.h"
+#include "timerstats.h"
+
+static unsigned long ulStart;
+static unsigned long ulCalls;
+static unsigned long ulWorst;
+static const char *pcWorst = "-";
+
+/* Timers of the batch check, and how often each one fired */
+#define timerstatsBATCH_SHORT_MS	20
+#define timerstatsBATCH_LONG_MS		200
+static TimerHandle_t xBatchTimers[2];
+static volatile unsigned long ulBatchFired[2];
+
+/*
+	prvBatchCallback()
+	- Description: Counts an expiry of a batch check timer
+	- Parameters: xTimer - the timer
+*/
+static void prvBatchCallback( TimerHandle_t xTimer ) {
+	ulBatchFired[(unsigned long) pvTimerGetTimerID(xTimer)]++;
+}
+
+/*
+	vTimerStatsEnter()
+	- Description: A callback is about to run
+	- Parameters: N/A
+*/
+void vTimerStatsEnter( void ) {
+	ulStart = ulHRTimeGet();
+}
+
+/*
+	vTimerStatsExit()
+	- Description: A callback has returned
+	- Parameters: pvTimer - its timer
+*/
+void vTimerStatsExit( void *pvTimer ) {
+	unsigned long ulTime = ulHRTimeGet() - ulStart;
+
+	ulCalls++;
+	if (ulTime > ulWorst) {
+		ulWorst = ulTime;
+		pcWorst = pcTimerGetName((TimerHandle_t) pvTimer);
+	}
+}
+
+/*
+	vTimerStatsPrint()
+	- Description: Prints the callback count, the longest callback
+	and the timer commands dropped on a full queue on the console
+	- Parameters: N/A
+*/
+void vTimerStatsPrint( void ) {
+	printf("Timers: %lu callbacks, longest %lu us (%s)\r\n", ulCalls, ulWorst / hrtimeCOUNTS_PER_US, pcWorst);
+	printf("Timers: %lu commands dropped\r\n", (unsigned long) uxTimerGetDroppedCommands());
+}
+
+/*
+	vTimerStatsBatchTest()
+	- Description: Sends one batch that starts the short timer (by
+	changing its period) and starts and stops the long one, waits
+	past the short period and prints how often each fired (1 and 0)
+	- Parameters: N/A
+*/
+void vTimerStatsBatchTest( void ) {
+	static TimerOperation_t xOperations[3];
+	static TimerBatch_t xBatch;
+
+	if (xBatchTimers[0] == NULL) {
+		xBatchTimers[0] = xTimerCreate("BatchShort", 1, pdFALSE, (void *) 0, prvBatchCallback);
+		xBatchTimers[1] = xTimerCreate("BatchLong", timerstatsBATCH_LONG_MS / portTICK_RATE_MS, pdFALSE, (void *) 1, prvBatchCallback);
+	}
+	if (xBatch.xPending != pdFALSE) {
+		printf("Batch: previous batch still pending\r\n");
+		return;
+	}
+	ulBatchFired[0] = 0;
+	ulBatchFired[1] = 0;
+
+	xOperations[0].xTimer = xBatchTimers[0];
+	xOperations[0].xCommandID = tmrCOMMAND_CHANGE_PERIOD;
+	xOperations[0].xNewPeriod = timerstatsBATCH_SHORT_MS / portTICK_RATE_MS;
+	xOperations[1].xTimer = xBatchTimers[1];
+	xOperations[1].xCommandID = tmrCOMMAND_START;
+	xOperations[2].xTimer = xBatchTimers[1];
+	xOperations[2].xCommandID = tmrCOMMAND_STOP;
+	xBatch.pxOperations = xOperations;
+	xBatch.uxCount = 3;
+
+	if (xTimerBatchCommand(&xBatch, 0) != pdPASS) {
+		printf("Batch: timer queue full\r\n");
+		return;
+	}
+	vTaskDelay((timerstatsBATCH_SHORT_MS * 3) / portTICK_RATE_MS);
+
+	printf("Batch: 3 operations in 1 queue message, %s, short fired %lu (expect 1), long fired %lu (expect 0)\r\n",
+		(xBatch.xPending != pdFALSE) ? "pending" : "applied", ulBatchFired[0], ulBatchFired[1]);
+}
@@ -0,0 +1,9 @@
+#ifndef TIMERSTATS_H
+#define TIMERSTATS_H
+
+void vTimerStatsEnter( void );
+void vTimerStatsExit( void *pvTimer );
+void vTimerStatsPrint( void );
+void vTimerStatsBatchTest( void );
+
+#endif
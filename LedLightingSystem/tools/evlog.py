@@ -0,0 +1,57 @@
+#!/usr/bin/env python
+"""
+Decodes an event log dump (the "log" console command, see evlog.c)
+from a capture of the console output and prints one event per line.
+
+    python evlog.py capture.bin
+
+Anything before the "EVLG" marker (the echoed command) is skipped.
+
+Wesley Fung (fungw@tcd.ie)
+"""
+
+import struct
+import sys
+
+MAGIC = b'EVLG'
+
+# type: (name, argument formatter) -- keep in step with evlog.h
+TYPES = {
+    1: ('button press', lambda a: 'dev %d inputs 0x%04x' % (a >> 16, a & 0xFFFF)),
+    2: ('button release', lambda a: 'dev %d inputs 0x%04x' % (a >> 16, a & 0xFFFF)),
+    3: ('touch', lambda a: 'x %d y %d' % (a >> 12, a & 0xFFF)),
+    4: ('command', lambda a: 'action %d id %d value %d' % (a >> 16, (a >> 8) & 0xFF, a & 0xFF)),
+    5: ('i2c write', lambda a: 'dev %d reg 0x%02x len %d' % (a >> 16, (a >> 8) & 0xFF, a & 0xFF)),
+}
+
+
+def decode(data):
+    start = data.find(MAGIC)
+    if start < 0:
+        sys.exit('no event log dump found')
+    count, hz = struct.unpack_from('<HH', data, start + 4)
+    offset = start + 8
+    if len(data) < offset + count * 8:
+        sys.exit('dump truncated: %d of %d entries' % ((len(data) - offset) // 8, count))
+    first = None
+    for _ in range(count):
+        tick, event = struct.unpack_from('<II', data, offset)
+        offset += 8
+        if first is None:
+            first = tick
+        kind, arg = event >> 24, event & 0xFFFFFF
+        name, fmt = TYPES.get(kind, ('type %d' % kind, lambda a: '0x%06x' % a))
+        # Ticks are 32 bits and may wrap within one dump
+        elapsed = ((tick - first) & 0xFFFFFFFF) / float(hz)
+        print('%10d  +%9.3fs  %-14s %s' % (tick, elapsed, name, fmt(arg)))
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit(__doc__)
+    with open(sys.argv[1], 'rb') as capture:
+        decode(capture.read())
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,108 @@
+#!/usr/bin/env python
+"""
+Compiles the button key codes in keycodes.txt into an Aho-Corasick
+automaton and writes it out as const tables (../keycodes.c and
+../keycodes.h). The firmware then matches every code at once with a
+single table lookup per button press.
+
+Wesley Fung (fungw@tcd.ie)
+"""
+
+import os
+import sys
+
+NUM_KEYS = 4            # buttons handled by the gesture engine
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+
+def read_codes(path):
+    codes = []
+    for number, line in enumerate(open(path), 1):
+        line = line.split('#', 1)[0].split()
+        if not line:
+            continue
+        name, keys = line[0], [int(k) for k in line[1:]]
+        if not keys or min(keys) < 0 or max(keys) >= NUM_KEYS:
+            sys.exit('%s:%d: keys must be 0..%d' % (path, number, NUM_KEYS - 1))
+        codes.append((name.upper(), keys))
+    if len(codes) > 32:
+        sys.exit('%s: at most 32 codes' % path)
+    return codes
+
+
+def build(codes):
+    """Returns (next[state][key], match[state]) with failure links folded in."""
+    goto = [{}]
+    match = [0]
+    for index, (_, keys) in enumerate(codes):
+        state = 0
+        for key in keys:
+            if key not in goto[state]:
+                goto.append({})
+                match.append(0)
+                goto[state][key] = len(goto) - 1
+            state = goto[state][key]
+        match[state] |= 1 << index
+
+    nxt = [[0] * NUM_KEYS for _ in goto]
+    fail = [0] * len(goto)
+    queue = []
+    for key in range(NUM_KEYS):
+        if key in goto[0]:
+            nxt[0][key] = goto[0][key]
+            queue.append(goto[0][key])
+    # Breadth first, so a state's failure target is complete before it is used
+    while queue:
+        state = queue.pop(0)
+        match[state] |= match[fail[state]]
+        for key in range(NUM_KEYS):
+            if key in goto[state]:
+                child = goto[state][key]
+                fail[child] = nxt[fail[state]][key]
+                nxt[state][key] = child
+                queue.append(child)
+            else:
+                nxt[state][key] = nxt[fail[state]][key]
+    return nxt, match
+
+
+def main():
+    codes = read_codes(os.path.join(HERE, 'keycodes.txt'))
+    nxt, match = build(codes)
+    if len(nxt) > 256:
+        sys.exit('too many states for an unsigned char table')
+
+    banner = '/*\n\tGenerated by tools/keycodes.py from tools/keycodes.txt.\n\tDo not edit; change keycodes.txt and regenerate.\n*/\n'
+
+    h = [banner, '#ifndef KEYCODES_H', '#define KEYCODES_H', '']
+    h.append('/* Key codes; bit n of ulKeyMatch[] is code n */')
+    for index, (name, keys) in enumerate(codes):
+        h.append('#define keyCODE_%s\t\t%d\t/* %s */' % (name, index, ' '.join(str(k) for k in keys)))
+    h.append('#define keyNUM_CODES\t\t%d' % len(codes))
+    h.append('')
+    h.append('#define keyNUM_KEYS\t\t\t%d' % NUM_KEYS)
+    h.append('#define keyNUM_STATES\t\t%d' % len(nxt))
+    h.append('')
+    h.append('extern const unsigned char ucKeyNext[keyNUM_STATES][keyNUM_KEYS];')
+    h.append('extern const unsigned long ulKeyMatch[keyNUM_STATES];')
+    h.append('')
+    h.append('#endif')
+
+    c = [banner, '#include "keycodes.h"', '']
+    c.append('/* State after each key press, from each state */')
+    c.append('const unsigned char ucKeyNext[keyNUM_STATES][keyNUM_KEYS] = {')
+    c.append(',\n'.join('\t{ %s }' % ', '.join('%3d' % s for s in row) for row in nxt))
+    c.append('};')
+    c.append('')
+    c.append('/* Codes completed on reaching each state */')
+    c.append('const unsigned long ulKeyMatch[keyNUM_STATES] = {')
+    c.append(',\n'.join('\t0x%08XUL' % m for m in match))
+    c.append('};')
+
+    for name, lines in (('keycodes.h', h), ('keycodes.c', c)):
+        with open(os.path.join(HERE, '..', name), 'w') as out:
+            out.write('\n'.join(lines) + '\n')
+
+
+if __name__ == '__main__':
+    main()
@@ -9,6 +9,7 @@
 #include "ui.h"
 #include "lcd_grph.h"
 #include "commands.h"
+#include "coalesce.h"
 #include "FreeRTOS.h"
 #include "queue.h"
 #include "timers.h"
@@ -116,16 +117,12 @@ xQueueHandle xCmdUIQ;
 								if double click within time period.
 */
 void resetCounter (TimerHandle_t xTimerDoubleClick) {
-	Command cmd;
-	cmd.action = 3;
-	cmd.value = doubleClickID;
+	Command cmd = cmdPACK(cmdPRESET_RECALL, 0, doubleClickID, 0);
 	if (doubleClick == 2) {
-		xQueueSendToBack(xCmdUIQ, &cmd, 0);
+		xCoalescePost(cmd);
 	}
 	doubleClick = 0;
 	doubleClickID = 0;
-	xTimerReset(xTimerDoubleClick, 0);
-	xTimerStop(xTimerDoubleClick, 0);
 }
 
 /*
@@ -337,7 +334,6 @@ void drawSlider() {
 	- Parameters: n - Button pressed number
 */
 Command generateCmd(int n){
-	Command cmd;
 	int action;
 	int value;
 	
@@ -353,15 +349,15 @@ Command generateCmd(int n){
 		8 - SAVE PRESET 1
 		9 - SAVE PRESET 2
 	
-		ACTION: 0 - OFF
-						1 - ON
-						2 - SET STATE
+		ACTION: cmdSWITCH - OFF / ON
+						cmdDIM - PWM0 / PWM1
+						cmdPRESET_SAVE - SAVE PRESET
 	
 		POWER: Either 1 OR 5
 	*/
 	switch (((n==5)||(n==6))?POWER:((n==8)||(n==9))?n:slider[n].snap_state) {
 		case 1:
-			action = 0;
+			action = cmdSWITCH;
 		  value = 0;
 		  if ((n==3)||(n==4)) {
 				button[3].state = 0;
@@ -371,7 +367,7 @@ Command generateCmd(int n){
 			}
 			break;
 		case 2:
-			action = 1;
+			action = cmdDIM;
 			value = 2;
 			if ((n==3)||(n==4)) {
 				button[3].state = 1;
@@ -381,7 +377,7 @@ Command generateCmd(int n){
 			}
 			break;
 		case 3: 
-			action = 0;
+			action = cmdSWITCH;
 			value = 0;
 			if ((n==3)||(n==4)) {
 				button[3].state = 0;
@@ -391,7 +387,7 @@ Command generateCmd(int n){
 			}
 			break;
 		case 4:
-			action = 1;
+			action = cmdDIM;
 	    value = 4;
 			if ((n==3)||(n==4)) {
 				button[3].state = 1;
@@ -401,7 +397,7 @@ Command generateCmd(int n){
 			}
 			break;
 		case 5: 
-			action = 0;
+			action = cmdSWITCH;
 		  value = 1;
 			if ((n==3)||(n==4)) {
 				button[3].state = 1;
@@ -411,23 +407,19 @@ Command generateCmd(int n){
 			}
 			break;
 		case 8:
-			action = 2;
+			action = cmdPRESET_SAVE;
 			value = 0;
 			break;
 		case 9:
-			action = 2;
+			action = cmdPRESET_SAVE;
 			value = 1;
 			break;
 		default:
-			action = -1;
-			value = -1;
+			action = cmdNONE;
+			value = 0;
 			break;
 	}
-	cmd.value = value;
-	cmd.dimValue = value;
-	cmd.identifier = n;
-	cmd.action = action;
-	return cmd;
+	return cmdPACK(action, n, value, 0);
 }
 
 /*
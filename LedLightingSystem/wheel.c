@@ -0,0 +1,392 @@
+/*
+	Hierarchical timing wheel. Timers hang in doubly linked slot
+	lists on three wheels of 64 slots: the first wheel has one slot
+	per wheelRESOLUTION_MS, each slot of the next wheel covers a
+	whole turn of the one below. Starting, restarting and stopping a
+	timer is a constant time list operation whatever the number of
+	timers; when a lower wheel completes a turn, the next slot of
+	the wheel above is emptied into it. The kernel timers, by
+	contrast, keep one sorted list and insert in O(n).
+
+	The wheel task advances the wheels every wheelRESOLUTION_MS while
+	any timer is running, and sleeps otherwise. Callbacks run in that
+	task, one at a time, like kernel timer callbacks.
+
+	Wesley Fung (fungw@tcd.ie)
+*/
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "list.h"
+#include <stdio.h>
+#include "hrtime.h"
+#include "wheel.h"
+
+#define wheelSTACK_SIZE			( ( unsigned portBASE_TYPE ) 128 )
+
+#define wheelBITS				6
+#define wheelSLOTS				( 1UL << wheelBITS )
+#define wheelMASK				( wheelSLOTS - 1 )
+#define wheelLEVELS				3
+/* Longest delay the wheels can hold; longer timers are parked at the end */
+#define wheelSPAN				( 1UL << ( wheelBITS * wheelLEVELS ) )
+
+#define wheelRESOLUTION_TICKS	( wheelRESOLUTION_MS / portTICK_RATE_MS )
+
+static WheelLink xSlots[wheelLEVELS][wheelSLOTS];
+/* Wheel time: the next unit to be processed */
+static unsigned long ulNow;
+/* Tick that ulNow corresponds to */
+static portTickType xLastTick;
+static unsigned portBASE_TYPE uxActive;
+static xTaskHandle xWheelTask;
+
+static void vWheelTask( void *pvParameters );
+
+/*
+	prvUnlink()
+	- Description: Removes a timer from whichever list it is on;
+	interrupts must be masked
+	- Parameters: pxTimer - running timer
+*/
+static void prvUnlink( WheelTimer *pxTimer ) {
+	pxTimer->xLink.pxPrev->pxNext = pxTimer->xLink.pxNext;
+	pxTimer->xLink.pxNext->pxPrev = pxTimer->xLink.pxPrev;
+	pxTimer->xLink.pxNext = NULL;
+	uxActive--;
+}
+
+/*
+	prvLink()
+	- Description: Puts a timer in the slot for its expiry;
+	interrupts must be masked
+	- Parameters: pxTimer - stopped timer, ulExpiry set
+*/
+static void prvLink( WheelTimer *pxTimer ) {
+	unsigned long ulExpiry = pxTimer->ulExpiry;
+	unsigned long ulDelta;
+	WheelLink *pxHead;
+
+	if ((long) (ulExpiry - ulNow) < 0) {
+		ulExpiry = ulNow;
+	}
+	ulDelta = ulExpiry - ulNow;
+	if (ulDelta >= wheelSPAN) {
+		/* Park at the far end; cascading will put it back here later */
+		ulExpiry = ulNow + wheelSPAN - 1;
+		ulDelta = wheelSPAN - 1;
+	}
+
+	if (ulDelta < wheelSLOTS) {
+		pxHead = &xSlots[0][ulExpiry & wheelMASK];
+	} else if (ulDelta < wheelSLOTS * wheelSLOTS) {
+		pxHead = &xSlots[1][(ulExpiry >> wheelBITS) & wheelMASK];
+	} else {
+		pxHead = &xSlots[2][(ulExpiry >> (2 * wheelBITS)) & wheelMASK];
+	}
+
+	pxTimer->xLink.pxNext = pxHead;
+	pxTimer->xLink.pxPrev = pxHead->pxPrev;
+	pxHead->pxPrev->pxNext = &pxTimer->xLink;
+	pxHead->pxPrev = &pxTimer->xLink;
+	uxActive++;
+}
+
+/*
+	prvCascade()
+	- Description: Re-files every timer of one slot of an upper wheel
+	into the wheels below; interrupts must be masked
+	- Parameters: level - wheel
+								index - slot
+	- Returns: index, so the caller can tell if this wheel wrapped too
+*/
+static unsigned long prvCascade( unsigned portBASE_TYPE level, unsigned long index ) {
+	WheelLink *pxHead = &xSlots[level][index];
+	WheelTimer *pxTimer;
+
+	while (pxHead->pxNext != pxHead) {
+		pxTimer = (WheelTimer *) pxHead->pxNext;
+		prvUnlink(pxTimer);
+		prvLink(pxTimer);
+	}
+	return index;
+}
+
+/*
+	prvAdvance()
+	- Description: Processes every wheel unit up to the current tick
+	and runs the callbacks of the timers that expire
+	- Parameters: N/A
+*/
+static void prvAdvance( void ) {
+	WheelLink xDue;
+	WheelTimer *pxTimer;
+	unsigned long index;
+
+	for (;;) {
+		portENTER_CRITICAL();
+		if ((portTickType) (xTaskGetTickCount() - xLastTick) < wheelRESOLUTION_TICKS) {
+			portEXIT_CRITICAL();
+			return;
+		}
+		xLastTick += wheelRESOLUTION_TICKS;
+
+		index = ulNow & wheelMASK;
+		if ((index == 0) && (prvCascade(1, (ulNow >> wheelBITS) & wheelMASK) == 0)) {
+			prvCascade(2, (ulNow >> (2 * wheelBITS)) & wheelMASK);
+		}
+		ulNow++;
+
+		/* Move the due slot to a private list; timers stopped from a
+		callback are simply unlinked from it */
+		if (xSlots[0][index].pxNext == &xSlots[0][index]) {
+			portEXIT_CRITICAL();
+			continue;
+		}
+		xDue.pxNext = xSlots[0][index].pxNext;
+		xDue.pxPrev = xSlots[0][index].pxPrev;
+		xDue.pxNext->pxPrev = &xDue;
+		xDue.pxPrev->pxNext = &xDue;
+		xSlots[0][index].pxNext = xSlots[0][index].pxPrev = &xSlots[0][index];
+
+		while (xDue.pxNext != &xDue) {
+			pxTimer = (WheelTimer *) xDue.pxNext;
+			prvUnlink(pxTimer);
+			if (pxTimer->ucAutoReload) {
+				pxTimer->ulExpiry += pxTimer->ulPeriod;
+				prvLink(pxTimer);
+			}
+			portEXIT_CRITICAL();
+			pxTimer->pxCallback(pxTimer);
+			portENTER_CRITICAL();
+		}
+		portEXIT_CRITICAL();
+	}
+}
+
+/*
+	vStartWheel()
+	- Description: Empties the wheels and starts the wheel task
+	- Parameters: uxPriority - priority of the wheel task
+*/
+void vStartWheel( unsigned portBASE_TYPE uxPriority ) {
+	unsigned portBASE_TYPE level, slot;
+
+	for (level = 0; level < wheelLEVELS; level++) {
+		for (slot = 0; slot < wheelSLOTS; slot++) {
+			xSlots[level][slot].pxNext = xSlots[level][slot].pxPrev = &xSlots[level][slot];
+		}
+	}
+	xTaskCreate( vWheelTask, "Wheel", wheelSTACK_SIZE, NULL, uxPriority, &xWheelTask );
+}
+
+/*
+	vWheelTimerInit()
+	- Description: Sets up a stopped timer
+	- Parameters: pxTimer - timer storage
+								xPeriod - ticks from start to expiry (rounded up
+								to wheelRESOLUTION_MS)
+								xAutoReload - pdTRUE to repeat every period
+								pxCallback - called in the wheel task on expiry
+								pvContext - for the callback's use
+*/
+void vWheelTimerInit( WheelTimer *pxTimer, portTickType xPeriod, portBASE_TYPE xAutoReload, WheelCallback pxCallback, void *pvContext ) {
+	pxTimer->xLink.pxNext = NULL;
+	pxTimer->ulPeriod = (xPeriod + wheelRESOLUTION_TICKS - 1) / wheelRESOLUTION_TICKS;
+	if (pxTimer->ulPeriod == 0) {
+		pxTimer->ulPeriod = 1;
+	}
+	pxTimer->ucAutoReload = (xAutoReload != pdFALSE);
+	pxTimer->pxCallback = pxCallback;
+	pxTimer->pvContext = pvContext;
+}
+
+/*
+	vWheelStart()
+	- Description: Starts a timer one period from now, or restarts
+	it if it is already running. O(1).
+	- Parameters: pxTimer - timer
+*/
+void vWheelStart( WheelTimer *pxTimer ) {
+	portBASE_TYPE xWake;
+
+	portENTER_CRITICAL();
+	if (pxTimer->xLink.pxNext != NULL) {
+		prvUnlink(pxTimer);
+	}
+	xWake = (uxActive == 0);
+	if (xWake) {
+		/* Nothing was running: skip the idle time instead of replaying it */
+		xLastTick = xTaskGetTickCount();
+	}
+	pxTimer->ulExpiry = ulNow + pxTimer->ulPeriod;
+	prvLink(pxTimer);
+	portEXIT_CRITICAL();
+
+	if (xWake && (xWheelTask != NULL)) {
+		xTaskNotifyGive(xWheelTask);
+	}
+}
+
+/*
+	vWheelStop()
+	- Description: Stops a timer if it is running. O(1).
+	- Parameters: pxTimer - timer
+*/
+void vWheelStop( WheelTimer *pxTimer ) {
+	portENTER_CRITICAL();
+	if (pxTimer->xLink.pxNext != NULL) {
+		prvUnlink(pxTimer);
+	}
+	portEXIT_CRITICAL();
+}
+
+/*
+	xWheelIsActive()
+	- Description: pdTRUE while a timer is running
+	- Parameters: pxTimer - timer
+*/
+portBASE_TYPE xWheelIsActive( const WheelTimer *pxTimer ) {
+	return (pxTimer->xLink.pxNext != NULL) ? pdTRUE : pdFALSE;
+}
+
+/*
+	portTASK_FUNCTION()
+	- Description: Advances the wheels every wheelRESOLUTION_MS while
+	timers are running; sleeps until one is started otherwise
+	- Parameters: vWheelTask - Task
+								pvParameters - Misc parameters
+*/
+static portTASK_FUNCTION( vWheelTask, pvParameters ) {
+	portTickType xDelay;
+
+	( void ) pvParameters;
+
+	for (;;) {
+		if (uxActive == 0) {
+			ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		}
+		xDelay = xLastTick + wheelRESOLUTION_TICKS - xTaskGetTickCount();
+		if ((long) xDelay > 0) {
+			vTaskDelay(xDelay);
+		}
+		prvAdvance();
+	}
+}
+
+#if wheelBENCHMARK == 1
+
+#define wheelBENCH_MAX			1000
+
+/* Only one of the two structures is under test at a time */
+static union {
+	WheelTimer xTimers[wheelBENCH_MAX];
+	ListItem_t xItems[wheelBENCH_MAX];
+} xBench;
+static unsigned long ulSeed;
+
+/*
+	prvRandom()
+	- Description: Pseudo random delay of one to two minutes (ticks),
+	so no benchmark timer expires while it runs
+	- Parameters: N/A
+*/
+static portTickType prvRandom( void ) {
+	ulSeed = ulSeed * 1103515245UL + 12345UL;
+	return 60000 + (portTickType) ((ulSeed >> 8) % 60000);
+}
+
+static void prvBenchCallback( WheelTimer *pxTimer ) {
+	( void ) pxTimer;
+}
+
+/*
+	prvBenchList()
+	- Description: Times n restarts of n running timers kept the way
+	the kernel timer service keeps them: remove, then vListInsert()
+	into one list sorted by expiry. (The kernel also passes every
+	command through its timer queue, which is not counted here.)
+	- Parameters: n - timers
+	- Returns: high resolution counts for the n restarts
+*/
+static unsigned long prvBenchList( unsigned portBASE_TYPE n ) {
+	List_t xList;
+	unsigned portBASE_TYPE i;
+	unsigned long ulStart;
+	portTickType xNow = xTaskGetTickCount();
+
+	vListInitialise(&xList);
+	for (i = 0; i < n; i++) {
+		vListInitialiseItem(&xBench.xItems[i]);
+		listSET_LIST_ITEM_VALUE(&xBench.xItems[i], xNow + prvRandom());
+		vListInsert(&xList, &xBench.xItems[i]);
+	}
+	ulStart = ulHRTimeGet();
+	for (i = 0; i < n; i++) {
+		uxListRemove(&xBench.xItems[i]);
+		listSET_LIST_ITEM_VALUE(&xBench.xItems[i], xNow + prvRandom());
+		vListInsert(&xList, &xBench.xItems[i]);
+	}
+	return ulHRTimeGet() - ulStart;
+}
+
+/*
+	prvBenchWheel()
+	- Description: Times n restarts of n running wheel timers
+	- Parameters: n - timers
+	- Returns: high resolution counts for the n restarts
+*/
+static unsigned long prvBenchWheel( unsigned portBASE_TYPE n ) {
+	unsigned portBASE_TYPE i;
+	unsigned long ulStart, ulTime;
+
+	for (i = 0; i < n; i++) {
+		vWheelTimerInit(&xBench.xTimers[i], prvRandom(), pdFALSE, prvBenchCallback, NULL);
+		vWheelStart(&xBench.xTimers[i]);
+	}
+	ulStart = ulHRTimeGet();
+	for (i = 0; i < n; i++) {
+		xBench.xTimers[i].ulPeriod = prvRandom() / wheelRESOLUTION_TICKS;
+		vWheelStart(&xBench.xTimers[i]);
+	}
+	ulTime = ulHRTimeGet() - ulStart;
+	for (i = 0; i < n; i++) {
+		vWheelStop(&xBench.xTimers[i]);
+	}
+	return ulTime;
+}
+
+/*
+	vWheelBenchmark()
+	- Description: Prints the average cost of restarting a timer with
+	10, 100 and 1000 timers running, for a sorted list and for the
+	wheel. Runs at the highest task priority; the scheduler is not
+	suspended, since the timestamps depend on the tick count.
+	- Parameters: N/A
+*/
+void vWheelBenchmark( void ) {
+	static const unsigned portBASE_TYPE uxCounts[] = { 10, 100, 1000 };
+	unsigned long ulList[3], ulWheel[3];
+	unsigned portBASE_TYPE i, n;
+	unsigned portBASE_TYPE uxPriority = uxTaskPriorityGet(NULL);
+
+	vTaskPrioritySet(NULL, configMAX_PRIORITIES - 1);
+	for (i = 0; i < 3; i++) {
+		ulSeed = 1;
+		ulList[i] = prvBenchList(uxCounts[i]);
+		ulSeed = 1;
+		ulWheel[i] = prvBenchWheel(uxCounts[i]);
+	}
+	vTaskPrioritySet(NULL, uxPriority);
+
+	for (i = 0; i < 3; i++) {
+		n = uxCounts[i];
+		/* Tenths of a microsecond per restart */
+		ulList[i] = ulList[i] * 10 / (hrtimeCOUNTS_PER_US * n);
+		ulWheel[i] = ulWheel[i] * 10 / (hrtimeCOUNTS_PER_US * n);
+		printf("%4u timers: list %lu.%lu us, wheel %lu.%lu us per restart\r\n",
+			(unsigned) n, ulList[i] / 10, ulList[i] % 10, ulWheel[i] / 10, ulWheel[i] % 10);
+	}
+}
+
+#endif
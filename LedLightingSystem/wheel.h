@@ -0,0 +1,42 @@
+#ifndef WHEEL_H
+#define WHEEL_H
+
+#include "FreeRTOS.h"
+
+/* Wheel granularity (ms); timers expire on a multiple of this */
+#define wheelRESOLUTION_MS		10
+
+/* Build the "wheel" console benchmark (needs about 28 KB of RAM) and
+start the wheel task for it; off by default */
+#define wheelBENCHMARK			0
+
+struct WheelTimer;
+typedef void (*WheelCallback)( struct WheelTimer *pxTimer );
+
+typedef struct WheelLink {
+	struct WheelLink *pxNext;
+	struct WheelLink *pxPrev;
+} WheelLink;
+
+/*
+	A wheel timer. The caller owns the storage; initialise it with
+	vWheelTimerInit() and leave the fields alone afterwards, except
+	pvContext.
+*/
+typedef struct WheelTimer {
+	WheelLink xLink;			/* slot list; pxNext is NULL while stopped */
+	unsigned long ulExpiry;		/* wheel time of expiry */
+	unsigned long ulPeriod;		/* in wheel units, at least 1 */
+	WheelCallback pxCallback;
+	void *pvContext;
+	unsigned char ucAutoReload;
+} WheelTimer;
+
+void vStartWheel( unsigned portBASE_TYPE uxPriority );
+void vWheelTimerInit( WheelTimer *pxTimer, portTickType xPeriod, portBASE_TYPE xAutoReload, WheelCallback pxCallback, void *pvContext );
+void vWheelStart( WheelTimer *pxTimer );
+void vWheelStop( WheelTimer *pxTimer );
+portBASE_TYPE xWheelIsActive( const WheelTimer *pxTimer );
+void vWheelBenchmark( void );
+
+#endif
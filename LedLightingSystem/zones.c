@@ -0,0 +1,94 @@
+/*
+	Lighting zones. Each zone is one LED output on one of the
+	PCA9532 expanders; zoneMap[] gives the (device, pin) for each.
+	Zones are staged individually and flushed together, so any
+	number of zone changes costs one transaction per expander.
+
+	Wesley Fung (fungw@tcd.ie)
+*/
+
+#include "FreeRTOS.h"
+#include "pca9532.h"
+#include "zones.h"
+
+typedef struct ZonePin {
+	unsigned char device;
+	unsigned char pin;
+} ZonePin;
+
+/* The EA board has its four LEDs on PCA9532 pins 8-11 (LS2) */
+static const ZonePin zoneMap[NUM_ZONES] = {
+	{ 0, 8 },	/* Whiteboard */
+	{ 0, 9 },	/* Lecturer */
+	{ 0, 10 },	/* Seating */
+	{ 0, 11 }	/* Aisles */
+};
+
+/*
+	vZoneSet()
+	- Description: Stages a new mode for a zone
+	- Parameters: zone - zone number
+								mode - ZONE_OFF / ZONE_ON / ZONE_PWM0 / ZONE_PWM1
+*/
+void vZoneSet( unsigned portBASE_TYPE zone, unsigned char mode ) {
+	const ZonePin *pxPin = &zoneMap[zone];
+	unsigned char shift = (pxPin->pin % 4) * 2;
+
+	vPCA9532SetBits(pxPin->device, PCA9532_LS0 + pxPin->pin / 4, 3 << shift, mode << shift);
+}
+
+/*
+	ucZoneGet()
+	- Description: Mode of a zone as last set
+	- Parameters: zone - zone number
+*/
+unsigned char ucZoneGet( unsigned portBASE_TYPE zone ) {
+	const ZonePin *pxPin = &zoneMap[zone];
+
+	return (ucPCA9532Get(pxPin->device, PCA9532_LS0 + pxPin->pin / 4) >> ((pxPin->pin % 4) * 2)) & 3;
+}
+
+/*
+	uxZoneDevice()
+	- Description: Expander a zone is wired to
+	- Parameters: zone - zone number
+*/
+unsigned portBASE_TYPE uxZoneDevice( unsigned portBASE_TYPE zone ) {
+	return zoneMap[zone].device;
+}
+
+/*
+	vZonesCompose()
+	- Description: LED selectors (LS0..LS3) of one expander with its
+	zones in the given modes and its other pins as staged. Nothing
+	is staged; this is for frames written outside the mirror.
+	- Parameters: dev - expander
+								pucModes - mode of each zone
+								pucSelectors - receives LS0..LS3
+*/
+void vZonesCompose( unsigned portBASE_TYPE dev, const unsigned char *pucModes, unsigned char *pucSelectors ) {
+	unsigned portBASE_TYPE zone;
+	unsigned char i;
+	unsigned char shift;
+
+	for (i = 0; i < 4; i++) {
+		pucSelectors[i] = ucPCA9532Get(dev, PCA9532_LS0 + i);
+	}
+	for (zone = 0; zone < NUM_ZONES; zone++) {
+		if (zoneMap[zone].device == dev) {
+			shift = (zoneMap[zone].pin % 4) * 2;
+			i = zoneMap[zone].pin / 4;
+			pucSelectors[i] = (pucSelectors[i] & ~(3 << shift)) | ((pucModes[zone] & 3) << shift);
+		}
+	}
+}
+
+/*
+	xZonesFlush()
+	- Description: Writes all staged zone changes, one transaction
+	per expander with changes
+	- Parameters: N/A
+*/
+portBASE_TYPE xZonesFlush( void ) {
+	return xPCA9532Flush();
+}
@@ -0,0 +1,21 @@
+#ifndef ZONES_H
+#define ZONES_H
+
+#include "FreeRTOS.h"
+
+/* Lighting zones; the UI drives zones 0-3 */
+#define NUM_ZONES			4
+
+/* Zone modes (PCA9532 LED selector values) */
+#define ZONE_OFF			0
+#define ZONE_ON				1
+#define ZONE_PWM0			2
+#define ZONE_PWM1			3
+
+void vZoneSet( unsigned portBASE_TYPE zone, unsigned char mode );
+unsigned char ucZoneGet( unsigned portBASE_TYPE zone );
+unsigned portBASE_TYPE uxZoneDevice( unsigned portBASE_TYPE zone );
+void vZonesCompose( unsigned portBASE_TYPE dev, const unsigned char *pucModes, unsigned char *pucSelectors );
+portBASE_TYPE xZonesFlush( void );
+
+#endif